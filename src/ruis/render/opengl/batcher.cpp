@@ -0,0 +1,252 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "batcher.hpp"
+
+#include <utki/debug.hpp>
+
+#include "index_buffer.hpp"
+#include "shader_base.hpp"
+#include "stream_buffer.hpp"
+#include "util.hpp"
+#include "vertex_array.hpp"
+#include "vertex_buffer.hpp"
+
+using namespace ruis::render::opengl;
+
+batcher::batcher() :
+	vao([]() {
+		if (GLEW_ARB_vertex_array_object) {
+			// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+			GLuint ret;
+			glGenVertexArrays(1, &ret);
+			assert_opengl_no_error();
+			return ret;
+		} else {
+			return GLuint(0);
+		}
+	}())
+{}
+
+batcher::~batcher()
+{
+	if (GLEW_ARB_vertex_array_object) {
+		glDeleteVertexArrays(1, &this->vao);
+	}
+}
+
+bool batcher::append(const shader_base& shader, const r4::matrix4<float>& m, const vertex_array& va)
+{
+	if (va.rendering_mode == ruis::render::vertex_array::mode::line_loop || va.buffers.empty() ||
+		va.buffers.size() > 2)
+	{
+		return false;
+	}
+
+	ASSERT(dynamic_cast<const index_buffer*>(&va.indices.get()))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ivbo = static_cast<const index_buffer&>(va.indices.get());
+	if (ivbo.get_data().empty()) {
+		return false;
+	}
+
+	// interleaved vertex buffers do not keep CPU-side copy of the data, so those cannot be batched
+	const auto* pos_vbo_ptr = dynamic_cast<const vertex_buffer*>(&va.buffers.front().get());
+	if (!pos_vbo_ptr || pos_vbo_ptr->get_data().empty()) {
+		return false;
+	}
+	const auto& pos_vbo = *pos_vbo_ptr;
+
+	const vertex_buffer* attr_vbo = nullptr;
+	if (va.buffers.size() == 2) {
+		attr_vbo = dynamic_cast<const vertex_buffer*>(&va.buffers.back().get());
+		if (!attr_vbo || attr_vbo->get_data().empty() || attr_vbo->num_vertices != pos_vbo.num_vertices) {
+			return false;
+		}
+	}
+
+	GLint num_attr_components = attr_vbo ? attr_vbo->num_components : 0;
+
+	if (!this->empty() &&
+		(this->shader != &shader || this->num_attribute_components != num_attr_components ||
+		 this->positions.size() + pos_vbo.num_vertices > max_vertices_per_batch))
+	{
+		this->flush();
+	}
+
+	this->shader = &shader;
+	this->num_attribute_components = num_attr_components;
+
+	auto base_index = uint16_t(this->positions.size());
+
+	// transform positions
+	auto pos_data = pos_vbo.get_data();
+	for (auto p = pos_data.begin(); p != pos_data.end(); p += pos_vbo.num_components) {
+		r4::vector4<float> v{0, 0, 0, 1};
+		for (GLint i = 0; i != pos_vbo.num_components; ++i) {
+			v[i] = *std::next(p, i);
+		}
+		this->positions.push_back(m * v);
+	}
+
+	if (attr_vbo) {
+		auto attr_data = attr_vbo->get_data();
+		this->attributes.insert(this->attributes.end(), attr_data.begin(), attr_data.end());
+	}
+
+	// convert indices to triangles list
+	auto idx = ivbo.get_data().subspan(0, size_t(va.num_indices));
+	auto add_triangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+		this->indices.push_back(uint16_t(base_index + a));
+		this->indices.push_back(uint16_t(base_index + b));
+		this->indices.push_back(uint16_t(base_index + c));
+	};
+
+	switch (va.rendering_mode) {
+		case ruis::render::vertex_array::mode::triangles:
+			for (auto i : idx) {
+				this->indices.push_back(uint16_t(base_index + i));
+			}
+			break;
+		case ruis::render::vertex_array::mode::triangle_strip:
+			for (size_t i = 2; i < idx.size(); ++i) {
+				// keep the winding order of the strip triangles
+				if (i % 2 == 0) {
+					add_triangle(idx[i - 2], idx[i - 1], idx[i]);
+				} else {
+					add_triangle(idx[i - 1], idx[i - 2], idx[i]);
+				}
+			}
+			break;
+		case ruis::render::vertex_array::mode::triangle_fan:
+			for (size_t i = 2; i < idx.size(); ++i) {
+				add_triangle(idx[0], idx[i - 1], idx[i]);
+			}
+			break;
+		default:
+			ASSERT(false)
+			break;
+	}
+
+	return true;
+}
+
+void batcher::flush()
+{
+	if (this->empty() || this->flushing) {
+		return;
+	}
+
+	this->flushing = true;
+
+	ASSERT(this->shader)
+	ASSERT(this->shader->is_bound())
+
+	// positions are already transformed
+	this->shader->set_matrix(r4::matrix4<float>().set_identity());
+
+	auto& ctx = this->shader->context.get();
+
+	// write data to the stream buffers before binding the vertex array object,
+	// because the first access to the index stream creates and binds the buffer
+	auto& vstream = ctx.get_vertex_stream();
+	auto& istream = ctx.get_index_stream();
+
+	// reserve space for all the vertex data of the draw call,
+	// so that the ring buffer does not wrap around in between the writes
+	size_t vertex_data_size = stream_buffer::get_reserve_size(utki::make_span(this->positions));
+	if (this->num_attribute_components != 0) {
+		vertex_data_size += stream_buffer::get_reserve_size(utki::make_span(this->attributes));
+	}
+	vstream.reserve(vertex_data_size);
+
+	size_t positions_offset = vstream.write(utki::make_span(this->positions));
+	size_t attributes_offset = 0;
+	if (this->num_attribute_components != 0) {
+		attributes_offset = vstream.write(utki::make_span(this->attributes));
+	}
+	size_t indices_offset = istream.write(utki::make_span(this->indices));
+
+	if (GLEW_ARB_vertex_array_object) {
+		glBindVertexArray(this->vao);
+		assert_opengl_no_error();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vstream.buffer);
+	assert_opengl_no_error();
+
+	glVertexAttribPointer(
+		0,
+		4,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		// NOLINTNEXTLINE(performance-no-int-to-ptr)
+		reinterpret_cast<const GLvoid*>(positions_offset)
+	);
+	assert_opengl_no_error();
+	glEnableVertexAttribArray(0);
+	assert_opengl_no_error();
+
+	if (this->num_attribute_components != 0) {
+		glVertexAttribPointer(
+			1,
+			this->num_attribute_components,
+			GL_FLOAT,
+			GL_FALSE,
+			0,
+			// NOLINTNEXTLINE(performance-no-int-to-ptr)
+			reinterpret_cast<const GLvoid*>(attributes_offset)
+		);
+		assert_opengl_no_error();
+		glEnableVertexAttribArray(1);
+		assert_opengl_no_error();
+	} else if (GLEW_ARB_vertex_array_object) {
+		glDisableVertexAttribArray(1);
+		assert_opengl_no_error();
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, istream.buffer);
+	assert_opengl_no_error();
+
+	glDrawElements(
+		GL_TRIANGLES,
+		GLsizei(this->indices.size()),
+		GL_UNSIGNED_SHORT,
+		// NOLINTNEXTLINE(performance-no-int-to-ptr)
+		reinterpret_cast<const GLvoid*>(indices_offset)
+	);
+	assert_opengl_no_error();
+
+	if (GLEW_ARB_vertex_array_object) {
+		// see comment in shader_base::draw() on why unbinding the vertex array
+		glBindVertexArray(0);
+		assert_opengl_no_error();
+	}
+
+	++ctx.get_draw_statistics().num_draw_calls;
+
+	this->positions.clear();
+	this->attributes.clear();
+	this->indices.clear();
+
+	this->flushing = false;
+}
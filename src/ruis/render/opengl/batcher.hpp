@@ -0,0 +1,112 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <GL/glew.h>
+#include <r4/matrix.hpp>
+#include <r4/vector.hpp>
+
+namespace ruis::render::opengl {
+
+class shader_base;
+class vertex_array;
+
+/**
+ * @brief Draw call batcher.
+ * Accumulates geometry of consecutive draws which are done with the same OpenGL state
+ * (shader program, uniforms, textures, blending etc.). On flush, the accumulated geometry
+ * is written to the context's vertex and index stream buffers, see stream_buffer.
+ * Vertex positions are transformed by the per-draw matrix on the CPU, so that all
+ * the accumulated geometry can be drawn with a single draw call using identity matrix.
+ * The accumulated geometry is flushed, i.e. drawn, before any OpenGL state change
+ * done via the context, see context::flush_batch().
+ */
+class batcher
+{
+public:
+	/**
+	 * @brief Maximum number of vertices in a vertex buffer which can be batched.
+	 * Only vertex buffers of up to this size keep a CPU-side copy of the vertex data.
+	 */
+	constexpr static const size_t max_vertices_per_draw = 1024;
+
+	/**
+	 * @brief Maximum number of vertices accumulated in a single batch.
+	 * Batch indices are 16-bit.
+	 */
+	constexpr static const size_t max_vertices_per_batch = std::numeric_limits<uint16_t>::max();
+
+private:
+	const GLuint vao;
+
+	// shader which the accumulated geometry is drawn with
+	const shader_base* shader = nullptr;
+
+	// number of components of the second vertex attribute, 0 if there is no second attribute
+	GLint num_attribute_components = 0;
+
+	std::vector<r4::vector4<float>> positions;
+	std::vector<float> attributes;
+	std::vector<uint16_t> indices;
+
+	bool flushing = false;
+
+public:
+	batcher();
+
+	batcher(const batcher&) = delete;
+	batcher& operator=(const batcher&) = delete;
+
+	batcher(batcher&&) = delete;
+	batcher& operator=(batcher&&) = delete;
+
+	~batcher();
+
+	/**
+	 * @brief Add draw to the batch.
+	 * The shader program, textures and uniforms of the draw are expected to be already set.
+	 * @param shader - shader to draw the vertex array with.
+	 * @param m - transformation matrix.
+	 * @param va - vertex array to draw.
+	 * @return true if the draw was added to the batch.
+	 * @return false if the vertex array cannot be batched, in this case the pending batch is flushed
+	 *         and the caller is supposed to draw the vertex array directly.
+	 */
+	bool append(const shader_base& shader, const r4::matrix4<float>& m, const vertex_array& va);
+
+	/**
+	 * @brief Draw the accumulated geometry.
+	 * Does nothing if there is no accumulated geometry.
+	 */
+	void flush();
+
+	bool empty() const noexcept
+	{
+		return this->indices.empty();
+	}
+};
+
+} // namespace ruis::render::opengl
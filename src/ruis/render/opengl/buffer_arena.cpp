@@ -0,0 +1,192 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "buffer_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+buffer_arena::page::page(GLenum target) :
+	buffer([]() {
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		glGenBuffers(1, &ret);
+		assert_opengl_no_error();
+		return ret;
+	}())
+{
+	// Binding element array buffer changes the currently bound vertex array object state,
+	// vertex arrays are unbound after drawing, so no vertex array object is bound here.
+	glBindBuffer(target, this->buffer);
+	assert_opengl_no_error();
+
+	glBufferData(target, GLsizeiptr(page_size), nullptr, GL_STATIC_DRAW);
+	assert_opengl_no_error();
+
+	this->free_blocks.insert(std::make_pair(size_t(0), page_size));
+}
+
+buffer_arena::page::~page()
+{
+	glDeleteBuffers(1, &this->buffer);
+	assert_opengl_no_error();
+}
+
+buffer_arena::buffer_arena(GLenum target) :
+	target(target)
+{}
+
+buffer_arena::~buffer_arena()
+{
+	// all slices are expected to be freed before the arena is destroyed
+	ASSERT(
+		std::all_of(
+			this->pages.begin(),
+			this->pages.end(),
+			[](const auto& p) {
+				return p->num_allocations == 0;
+			}
+		)
+	)
+}
+
+buffer_arena::allocation buffer_arena::allocate(size_t size)
+{
+	if (size == 0 || size > max_allocation_size) {
+		throw std::length_error("buffer_arena::allocate(): slice size is out of range");
+	}
+
+	// round up to keep offsets of all blocks aligned
+	size = (size + alignment - 1) / alignment * alignment;
+
+	auto find_block = [size](page& p) {
+		return std::find_if(p.free_blocks.begin(), p.free_blocks.end(), [size](const auto& b) {
+			return b.second >= size;
+		});
+	};
+
+	page* pg = nullptr;
+	auto block = std::map<size_t, size_t>::iterator();
+
+	for (auto& p : this->pages) {
+		auto i = find_block(*p);
+		if (i != p->free_blocks.end()) {
+			pg = p.get();
+			block = i;
+			break;
+		}
+	}
+
+	if (!pg) {
+		this->pages.push_back(std::make_unique<page>(this->target));
+		pg = this->pages.back().get();
+		block = pg->free_blocks.begin();
+	}
+
+	ASSERT(block != pg->free_blocks.end())
+
+	allocation ret;
+	ret.p = pg;
+	ret.buffer = pg->buffer;
+	ret.offset = block->first;
+	ret.size = size;
+
+	auto remaining = block->second - size;
+	pg->free_blocks.erase(block);
+	if (remaining != 0) {
+		pg->free_blocks.insert(std::make_pair(ret.offset + size, remaining));
+	}
+
+	++pg->num_allocations;
+
+	return ret;
+}
+
+void buffer_arena::free(const allocation& a)
+{
+	ASSERT(!a.empty())
+
+	auto& free_blocks = a.p->free_blocks;
+
+	auto offset = a.offset;
+	auto size = a.size;
+
+	// merge with the following free block
+	auto next = free_blocks.find(offset + size);
+	if (next != free_blocks.end()) {
+		size += next->second;
+		free_blocks.erase(next);
+	}
+
+	// merge with the preceding free block
+	auto prev = free_blocks.lower_bound(offset);
+	if (prev != free_blocks.begin()) {
+		--prev;
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			size = 0;
+		}
+	}
+
+	if (size != 0) {
+		free_blocks.insert(std::make_pair(offset, size));
+	}
+
+	ASSERT(a.p->num_allocations != 0)
+	--a.p->num_allocations;
+
+	if (a.p->num_allocations == 0 && this->pages.size() > 1) {
+		auto i = std::find_if(this->pages.begin(), this->pages.end(), [&a](const auto& p) {
+			return p.get() == a.p;
+		});
+		ASSERT(i != this->pages.end())
+		this->pages.erase(i);
+	}
+}
+
+buffer_arena::statistics buffer_arena::get_statistics() const
+{
+	statistics ret;
+
+	ret.num_pages = this->pages.size();
+	ret.num_bytes_reserved = this->pages.size() * page_size;
+
+	size_t num_bytes_free = 0;
+
+	for (const auto& p : this->pages) {
+		ret.num_allocations += p->num_allocations;
+		ret.num_free_blocks += p->free_blocks.size();
+		for (const auto& b : p->free_blocks) {
+			num_bytes_free += b.second;
+			ret.largest_free_block = std::max(ret.largest_free_block, b.second);
+		}
+	}
+
+	ret.num_bytes_allocated = ret.num_bytes_reserved - num_bytes_free;
+
+	return ret;
+}
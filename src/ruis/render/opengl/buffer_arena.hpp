@@ -0,0 +1,191 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Suballocating buffer arena.
+ * Hands out slices of big OpenGL buffers, called pages, instead of creating
+ * a separate OpenGL buffer for every small vertex or index buffer.
+ * This way, thousands of small buffers do not have a per-buffer driver overhead,
+ * and draws using slices of the same page do not need to rebind the buffer.
+ *
+ * Each page keeps a list of free blocks sorted by offset. Allocation takes the first
+ * free block big enough, adjacent free blocks are merged when a slice is freed.
+ * Pages are created on demand and a page which becomes completely free is deleted,
+ * unless it is the last one.
+ */
+class buffer_arena
+{
+public:
+	/**
+	 * @brief Size of a single page in bytes.
+	 */
+	constexpr static const size_t page_size = size_t(1) * 1024 * 1024;
+
+	/**
+	 * @brief Maximum size of a slice in bytes.
+	 * Bigger buffers are supposed to have their own OpenGL buffer.
+	 */
+	constexpr static const size_t max_allocation_size = size_t(64) * 1024;
+
+	/**
+	 * @brief Alignment of slice offsets within the page.
+	 */
+	constexpr static const size_t alignment = 16;
+
+	const GLenum target;
+
+private:
+	struct page {
+		const GLuint buffer;
+
+		// offset -> size
+		std::map<size_t, size_t> free_blocks;
+
+		size_t num_allocations = 0;
+
+		page(GLenum target);
+
+		page(const page&) = delete;
+		page& operator=(const page&) = delete;
+
+		page(page&&) = delete;
+		page& operator=(page&&) = delete;
+
+		~page();
+	};
+
+	std::vector<std::unique_ptr<page>> pages;
+
+public:
+	/**
+	 * @brief Slice of a page.
+	 */
+	class allocation
+	{
+		friend class buffer_arena;
+
+		page* p = nullptr;
+
+	public:
+		GLuint buffer = 0;
+		size_t offset = 0;
+		size_t size = 0;
+
+		bool empty() const noexcept
+		{
+			return this->p == nullptr;
+		}
+	};
+
+	struct statistics {
+		/**
+		 * @brief Number of pages.
+		 */
+		size_t num_pages = 0;
+
+		/**
+		 * @brief Number of live slices.
+		 */
+		size_t num_allocations = 0;
+
+		/**
+		 * @brief Total size of all pages in bytes.
+		 */
+		size_t num_bytes_reserved = 0;
+
+		/**
+		 * @brief Total size of all live slices in bytes, including alignment padding.
+		 */
+		size_t num_bytes_allocated = 0;
+
+		/**
+		 * @brief Number of free blocks in all pages.
+		 */
+		size_t num_free_blocks = 0;
+
+		/**
+		 * @brief Size of the biggest free block in bytes.
+		 */
+		size_t largest_free_block = 0;
+
+		/**
+		 * @brief Get fragmentation of the free space.
+		 * @return value from 0 to 1, 0 means all free space of a page is a single block.
+		 */
+		float fragmentation() const noexcept
+		{
+			auto num_bytes_free = this->num_bytes_reserved - this->num_bytes_allocated;
+			if (num_bytes_free == 0) {
+				return 0;
+			}
+			return 1 - float(this->largest_free_block) / float(num_bytes_free);
+		}
+	};
+
+	/**
+	 * @brief Constructor.
+	 * No OpenGL buffers are created until the first allocation.
+	 * @param target - buffer binding target the pages are used with, e.g. GL_ARRAY_BUFFER.
+	 */
+	buffer_arena(GLenum target);
+
+	buffer_arena(const buffer_arena&) = delete;
+	buffer_arena& operator=(const buffer_arena&) = delete;
+
+	buffer_arena(buffer_arena&&) = delete;
+	buffer_arena& operator=(buffer_arena&&) = delete;
+
+	~buffer_arena();
+
+	/**
+	 * @brief Allocate a slice.
+	 * In case a new page is created, it is left bound to the arena's target.
+	 * @param size - size of the slice in bytes.
+	 * @return allocated slice.
+	 * @throw std::length_error - if the size is zero or exceeds max_allocation_size.
+	 */
+	allocation allocate(size_t size);
+
+	/**
+	 * @brief Free a slice.
+	 * @param a - slice to free, must be allocated from this arena.
+	 */
+	void free(const allocation& a);
+
+	/**
+	 * @brief Collect the arena statistics.
+	 * @return current statistics.
+	 */
+	statistics get_statistics() const;
+};
+
+} // namespace ruis::render::opengl
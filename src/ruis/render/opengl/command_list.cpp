@@ -0,0 +1,310 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "command_list.hpp"
+
+#include <limits>
+
+#include <utki/debug.hpp>
+
+#include "texture_2d.hpp"
+#include "util.hpp"
+#include "vertex_array.hpp"
+#include "vertex_buffer.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+bool is_equal(const context::render_state& a, const context::render_state& b)
+{
+	return a.viewport.p == b.viewport.p && a.viewport.d == b.viewport.d && //
+		a.scissor.p == b.scissor.p && a.scissor.d == b.scissor.d && //
+		a.scissor_enabled == b.scissor_enabled && //
+		a.depth_enabled == b.depth_enabled && //
+		a.depth_write_enabled == b.depth_write_enabled && //
+		a.depth_func == b.depth_func && //
+		a.blend_enabled == b.blend_enabled && //
+		a.blend_func == b.blend_func;
+}
+
+// Opaque draws overlapping each other can be reordered as long as their depth ranges are separated,
+// because the depth test keeps the closest fragment regardless of the drawing order.
+bool is_opaque(const context::render_state& rs)
+{
+	if (rs.blend_enabled || !rs.depth_enabled || !rs.depth_write_enabled) {
+		return false;
+	}
+
+	switch (rs.depth_func) {
+		case GL_LESS:
+		case GL_LEQUAL:
+		case GL_GREATER:
+		case GL_GEQUAL:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// sort key layout, from most significant bits:
+// 16 bits of shader program, 24 bits of texture, 24 bits of render state index
+uint64_t make_key(GLuint program, GLuint texture, size_t render_state_index)
+{
+	constexpr auto program_bits = 16;
+	constexpr auto texture_bits = 24;
+	constexpr auto state_bits = 24;
+
+	auto mask = [](auto bits) {
+		return (uint64_t(1) << bits) - 1;
+	};
+
+	return ((uint64_t(program) & mask(program_bits)) << (texture_bits + state_bits)) |
+		((uint64_t(texture) & mask(texture_bits)) << state_bits) | (uint64_t(render_state_index) & mask(state_bits));
+}
+} // namespace
+
+command_list::command_list(const context::render_state& rs, GLuint framebuffer) :
+	render_states({rs}),
+	framebuffer(framebuffer)
+{}
+
+size_t command_list::use_render_state()
+{
+	this->render_state_used = true;
+	return this->render_states.size() - 1;
+}
+
+void command_list::set_render_state(const context::render_state& rs)
+{
+	if (is_equal(rs, this->render_states.back())) {
+		return;
+	}
+
+	if (!this->render_state_used) {
+		// current render state was not referred by any command, just replace it
+		this->render_states.back() = rs;
+		return;
+	}
+
+	this->render_states.push_back(rs);
+	this->render_state_used = false;
+}
+
+void command_list::set_framebuffer(GLuint fbo)
+{
+	if (this->framebuffer == fbo) {
+		return;
+	}
+
+	this->barriers.push_back({
+		.command_type = barrier_command::type::framebuffer,
+		.value = fbo,
+		.render_state_index = this->use_render_state(),
+		.group_index = this->groups.size()
+	});
+	this->first_movable_group = this->groups.size();
+
+	this->framebuffer = fbo;
+}
+
+void command_list::clear(GLbitfield mask)
+{
+	this->barriers.push_back({
+		.command_type = barrier_command::type::clear,
+		.value = mask,
+		.render_state_index = this->use_render_state(),
+		.group_index = this->groups.size()
+	});
+	this->first_movable_group = this->groups.size();
+}
+
+command_list::box command_list::get_window_bounds(const r4::matrix4<float>& m, const vertex_array& va) const
+{
+	constexpr auto infinity = std::numeric_limits<float>::infinity();
+
+	const box unbounded = {
+		{-infinity, -infinity, -infinity},
+		{ infinity,  infinity,  infinity}
+	};
+
+	// interleaved vertex buffers do not track bounds
+	const auto* pos_vbo = va.buffers.empty() ? nullptr : dynamic_cast<const vertex_buffer*>(&va.buffers.front().get());
+	if (!pos_vbo) {
+		return unbounded;
+	}
+
+	const auto& vertex_bounds = pos_vbo->get_bounds();
+
+	box ret = {
+		{ infinity,  infinity,  infinity},
+		{-infinity, -infinity, -infinity}
+	};
+
+	// transform corners of the bounding box to normalized device coordinates
+	constexpr auto num_corners = 8;
+	for (unsigned i = 0; i != num_corners; ++i) {
+		r4::vector4<float> corner{
+			(i & 1) ? vertex_bounds.max.x() : vertex_bounds.min.x(), //
+			(i & 2) ? vertex_bounds.max.y() : vertex_bounds.min.y(),
+			(i & 4) ? vertex_bounds.max.z() : vertex_bounds.min.z(),
+			1
+		};
+
+		auto p = m * corner;
+
+		if (p.w() <= 0) {
+			// the corner is behind the viewer, bounds cannot be projected
+			return unbounded;
+		}
+
+		r4::vector3<float> ndc{p.x() / p.w(), p.y() / p.w(), p.z() / p.w()};
+
+		ret.unite({ndc, ndc});
+	}
+
+	// convert to window coordinates, the depth is left in normalized device coordinates
+	const auto& rs = this->render_states.back();
+
+	auto to_window = [&rs](const r4::vector3<float>& ndc) {
+		return r4::vector3<float>{
+			float(rs.viewport.p.x()) + (ndc.x() + 1) / 2 * float(rs.viewport.d.x()),
+			float(rs.viewport.p.y()) + (ndc.y() + 1) / 2 * float(rs.viewport.d.y()),
+			ndc.z()
+		};
+	};
+
+	ret.min = to_window(ret.min);
+	ret.max = to_window(ret.max);
+
+	if (rs.scissor_enabled) {
+		for (size_t i = 0; i != rs.scissor.p.size(); ++i) {
+			ret.min[i] = std::max(ret.min[i], float(rs.scissor.p[i]));
+			ret.max[i] = std::min(ret.max[i], float(rs.scissor.p[i] + rs.scissor.d[i]));
+		}
+	}
+
+	return ret;
+}
+
+void command_list::record_draw(
+	const shader_base& shader,
+	const r4::matrix4<float>& m,
+	const vertex_array& va,
+	const shader_base::draw_parameters& params
+)
+{
+	const auto& rs = this->render_states.back();
+
+	draw_command d{
+		.key = 0,
+		.shader = &shader,
+		.va = &va,
+		.matrix = m,
+		.params = params,
+		.render_state_index = this->use_render_state(),
+		.bounds = this->get_window_bounds(m, va),
+		.opaque = is_opaque(rs)
+	};
+
+	d.key = make_key(shader.program.p, params.texture ? params.texture->tex : 0, d.render_state_index);
+
+	// Look back for a group with the same key. The draw can be moved ahead of
+	// the groups recorded after that group only if it does not overlap them.
+	auto lookback_end = std::max(
+		this->first_movable_group,
+		this->groups.size() > max_lookback ? this->groups.size() - max_lookback : size_t(0)
+	);
+	for (auto i = this->groups.size(); i != lookback_end; --i) {
+		auto& g = this->groups[i - 1];
+
+		if (g.key == d.key && g.render_state_index == d.render_state_index) {
+			g.bounds.unite(d.bounds);
+			g.opaque = g.opaque && d.opaque;
+			g.draws.push_back(d);
+			return;
+		}
+
+		if (g.bounds.overlaps(d.bounds) && !(g.opaque && d.opaque && g.bounds.is_depth_separated(d.bounds))) {
+			break;
+		}
+	}
+
+	this->groups.push_back({
+		.key = d.key,
+		.render_state_index = d.render_state_index,
+		.bounds = d.bounds,
+		.opaque = d.opaque,
+		.draws = {d}
+	});
+}
+
+void command_list::submit(context& ctx)
+{
+	this->submitting = true;
+
+	auto execute_barrier = [this, &ctx](const barrier_command& b) {
+		switch (b.command_type) {
+			case barrier_command::type::framebuffer:
+				ctx.bind_framebuffer(b.value);
+				break;
+			case barrier_command::type::clear:
+				// scissor affects clearing
+				ctx.apply_render_state(this->render_states[b.render_state_index]);
+				ctx.flush_batch();
+				glClear(b.value);
+				assert_opengl_no_error();
+				break;
+		}
+	};
+
+	auto barrier = this->barriers.begin();
+
+	for (size_t i = 0; i != this->groups.size(); ++i) {
+		for (; barrier != this->barriers.end() && barrier->group_index == i; ++barrier) {
+			execute_barrier(*barrier);
+		}
+
+		const auto& g = this->groups[i];
+
+		ctx.apply_render_state(this->render_states[g.render_state_index]);
+
+		for (const auto& d : g.draws) {
+			d.shader->apply(d.params);
+			d.shader->draw(d.matrix, *d.va);
+		}
+	}
+
+	for (; barrier != this->barriers.end(); ++barrier) {
+		execute_barrier(*barrier);
+	}
+
+	ctx.apply_render_state(this->render_states.back());
+	ctx.bind_framebuffer(this->framebuffer);
+
+	this->groups.clear();
+	this->barriers.clear();
+	this->first_movable_group = 0;
+
+	this->render_states.erase(this->render_states.begin(), std::prev(this->render_states.end()));
+	this->render_state_used = false;
+
+	this->submitting = false;
+}
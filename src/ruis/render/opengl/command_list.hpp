@@ -0,0 +1,209 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+#include <r4/matrix.hpp>
+#include <r4/vector.hpp>
+
+#include "context.hpp"
+#include "shader_base.hpp"
+
+namespace ruis::render::opengl {
+
+class vertex_array;
+
+/**
+ * @brief Deferred rendering command list.
+ * Records draws, render state changes, framebuffer changes and clears
+ * to execute them later with submit().
+ *
+ * Framebuffer changes and clears are barriers, the draws are never moved across those.
+ * Between barriers the draws are reordered to group together the draws having equal sort key.
+ * The sort key is composed of shader program, texture and render state, so that grouping the draws
+ * minimizes program and texture switches and allows the batcher to merge the grouped draws.
+ * A draw is moved ahead of an earlier recorded draw only if their window space bounding rectangles
+ * do not overlap, or both draws are opaque and their depth ranges are separated, so the reordering
+ * does not change the rendering result. A draw is opaque if blending is disabled, depth test and depth writes
+ * are enabled and the depth function is one of GL_LESS, GL_LEQUAL, GL_GREATER or GL_GEQUAL. Draws with
+ * equal or unknown depth are never reordered, because the result of the depth test depends on their order.
+ */
+class command_list
+{
+public:
+	/**
+	 * @brief Maximum number of draw groups to look back for a group with equal sort key.
+	 * Limits the cost of recording a draw.
+	 */
+	constexpr static const size_t max_lookback = 64;
+
+private:
+	// recorded render states, the last one is the current render state
+	std::vector<context::render_state> render_states;
+
+	// whether the current render state was referred by a recorded command
+	bool render_state_used = false;
+
+	// current framebuffer
+	GLuint framebuffer;
+
+	/**
+	 * @brief Minimal separation of depth ranges of the draws to be reordered.
+	 * The depth values closer than that can become equal in the depth buffer of 16 bits precision.
+	 */
+	constexpr static const float min_depth_separation = 1.0f / float(1 << 16);
+
+	// window space bounding rectangle along with normalized device coordinates depth range
+	struct box {
+		r4::vector3<float> min;
+		r4::vector3<float> max;
+
+		bool overlaps(const box& r) const noexcept
+		{
+			return this->min.x() < r.max.x() && r.min.x() < this->max.x() && //
+				this->min.y() < r.max.y() && r.min.y() < this->max.y();
+		}
+
+		bool is_depth_separated(const box& r) const noexcept
+		{
+			return this->max.z() + min_depth_separation < r.min.z() ||
+				r.max.z() + min_depth_separation < this->min.z();
+		}
+
+		void unite(const box& r) noexcept
+		{
+			for (size_t i = 0; i != this->min.size(); ++i) {
+				this->min[i] = std::min(this->min[i], r.min[i]);
+				this->max[i] = std::max(this->max[i], r.max[i]);
+			}
+		}
+	};
+
+	struct draw_command {
+		uint64_t key;
+		const shader_base* shader;
+		const vertex_array* va;
+		r4::matrix4<float> matrix;
+		shader_base::draw_parameters params;
+		size_t render_state_index;
+		box bounds;
+		bool opaque;
+	};
+
+	// group of draws with equal sort key which are executed one after another
+	struct draw_group {
+		uint64_t key;
+		size_t render_state_index;
+		box bounds;
+		bool opaque;
+		std::vector<draw_command> draws;
+	};
+
+	struct barrier_command {
+		enum class type {
+			framebuffer,
+			clear
+		};
+
+		type command_type;
+
+		// framebuffer for framebuffer barrier, clear mask for clear barrier
+		GLuint value;
+
+		size_t render_state_index;
+
+		// barrier is executed before the draw group with this index
+		size_t group_index;
+	};
+
+	std::vector<draw_group> groups;
+	std::vector<barrier_command> barriers;
+
+	// index of the first draw group after the last barrier,
+	// draws are never moved before that group
+	size_t first_movable_group = 0;
+
+	// whether the recorded commands are being executed
+	bool submitting = false;
+
+	size_t use_render_state();
+
+	box get_window_bounds(const r4::matrix4<float>& m, const vertex_array& va) const;
+
+public:
+	command_list(const context::render_state& rs, GLuint framebuffer);
+
+	command_list(const command_list&) = delete;
+	command_list& operator=(const command_list&) = delete;
+
+	command_list(command_list&&) = delete;
+	command_list& operator=(command_list&&) = delete;
+
+	~command_list() = default;
+
+	const context::render_state& get_render_state() const noexcept
+	{
+		return this->render_states.back();
+	}
+
+	void set_render_state(const context::render_state& rs);
+
+	GLuint get_framebuffer() const noexcept
+	{
+		return this->framebuffer;
+	}
+
+	void set_framebuffer(GLuint fbo);
+
+	void clear(GLbitfield mask);
+
+	void record_draw(
+		const shader_base& shader,
+		const r4::matrix4<float>& m,
+		const vertex_array& va,
+		const shader_base::draw_parameters& params
+	);
+
+	bool empty() const noexcept
+	{
+		return this->groups.empty() && this->barriers.empty();
+	}
+
+	bool is_submitting() const noexcept
+	{
+		return this->submitting;
+	}
+
+	/**
+	 * @brief Execute recorded commands.
+	 * After execution the command list is emptied and the OpenGL state
+	 * is set to the current render state and framebuffer of the command list.
+	 * @param ctx - context to execute the commands in.
+	 */
+	void submit(context& ctx);
+};
+
+} // namespace ruis::render::opengl
@@ -0,0 +1,665 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "context.hpp"
+
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "batcher.hpp"
+#include "buffer_arena.hpp"
+#include "command_list.hpp"
+#include "deletion_queue.hpp"
+#include "memory_budget.hpp"
+#include "name_pool.hpp"
+#include "stream_buffer.hpp"
+#include "texture_upload_queue.hpp"
+#include "transform_buffer.hpp"
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+r4::rectangle<uint32_t> get_rectangle(GLenum name)
+{
+	std::array<GLint, 4> r{};
+	glGetIntegerv(name, r.data());
+
+#ifdef DEBUG
+	for (auto n : r) {
+		ASSERT(n >= 0)
+	}
+#endif
+
+	return {
+		uint32_t(r[0]), //
+		uint32_t(r[1]),
+		uint32_t(r[2]),
+		uint32_t(r[3])
+	};
+}
+
+GLenum get_enum(GLenum name)
+{
+	GLint val = 0;
+	glGetIntegerv(name, &val);
+	return GLenum(val);
+}
+
+bool get_boolean(GLenum name)
+{
+	GLboolean val = GL_FALSE;
+	glGetBooleanv(name, &val);
+	return val == GL_TRUE;
+}
+
+bool is_enabled(GLenum cap)
+{
+	return glIsEnabled(cap) ? true : false; // "? true : false" is to avoid warning under MSVC
+}
+
+void set_enabled(GLenum cap, bool enable)
+{
+	if (enable) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+	assert_opengl_no_error();
+}
+
+bool is_equal(const r4::rectangle<uint32_t>& a, const r4::rectangle<uint32_t>& b)
+{
+	return a.p == b.p && a.d == b.d;
+}
+} // namespace
+
+context::context() :
+	direct_state_access(GLEW_ARB_direct_state_access || GLEW_VERSION_4_5),
+	immutable_texture_storage(this->direct_state_access || GLEW_ARB_texture_storage || GLEW_VERSION_4_2),
+	transforms(transform_buffer::is_supported() ? std::make_unique<transform_buffer>() : nullptr),
+	vertex_arena(std::make_unique<buffer_arena>(GL_ARRAY_BUFFER)),
+	index_arena(std::make_unique<buffer_arena>(GL_ELEMENT_ARRAY_BUFFER)),
+	names(std::make_unique<name_pool>(this->direct_state_access)),
+	deletions(std::make_unique<deletion_queue>()),
+	budget(std::make_unique<memory_budget>(*this)),
+	uploads(std::make_unique<texture_upload_queue>(*this->names, *this->budget))
+{
+	this->invalidate();
+	this->default_framebuffer = this->state.framebuffer;
+}
+
+context::~context()
+{
+	if (!this->is_context_thread()) {
+		// The context is destroyed on some other thread, e.g. when the last object referring to it
+		// was released there. No OpenGL calls can be done on this thread, so leak the OpenGL objects
+		// owned by the context, they are freed along with the OpenGL context itself.
+		// NOLINTBEGIN(bugprone-unused-return-value)
+		this->batch.release();
+		this->transforms.release();
+		this->vertex_stream.release();
+		this->index_stream.release();
+		this->vertex_arena.release();
+		this->index_arena.release();
+		this->uploads.release();
+		this->names.release();
+		// NOLINTEND(bugprone-unused-return-value)
+
+		// the queued objects are leaked as well, drop them from the queue
+		this->deletions->pop_all();
+		return;
+	}
+
+	this->delete_queued_objects();
+}
+
+void context::delete_queued_objects()
+{
+	ASSERT(this->is_context_thread())
+
+	auto objects = this->deletions->pop_all();
+	if (objects.empty()) {
+		return;
+	}
+
+	std::vector<GLuint> buffers;
+	std::vector<GLuint> textures;
+	std::vector<GLuint> vertex_arrays;
+	std::vector<GLuint> framebuffers;
+
+	for (const auto& o : objects) {
+		switch (o.type) {
+			case deletion_queue::object_type::buffer:
+				buffers.push_back(o.name);
+				break;
+			case deletion_queue::object_type::arena_slice:
+				this->get_buffer_arena(o.target).free(o.slice);
+				break;
+			case deletion_queue::object_type::texture:
+				this->forget_texture(o.name);
+				textures.push_back(o.name);
+				break;
+			case deletion_queue::object_type::vertex_array:
+				vertex_arrays.push_back(o.name);
+				break;
+			case deletion_queue::object_type::framebuffer:
+				this->forget_framebuffer(o.name);
+				framebuffers.push_back(o.name);
+				break;
+			case deletion_queue::object_type::program:
+				// there is no batched version of glDeleteProgram()
+				this->forget_program(o.name);
+				glDeleteProgram(o.name);
+				assert_opengl_no_error();
+				break;
+			case deletion_queue::object_type::shader:
+				glDeleteShader(o.name);
+				assert_opengl_no_error();
+				break;
+		}
+	}
+
+	if (!buffers.empty()) {
+		glDeleteBuffers(GLsizei(buffers.size()), buffers.data());
+		assert_opengl_no_error();
+	}
+	if (!textures.empty()) {
+		glDeleteTextures(GLsizei(textures.size()), textures.data());
+		assert_opengl_no_error();
+	}
+	if (!vertex_arrays.empty()) {
+		glDeleteVertexArrays(GLsizei(vertex_arrays.size()), vertex_arrays.data());
+		assert_opengl_no_error();
+	}
+	if (!framebuffers.empty()) {
+		glDeleteFramebuffers(GLsizei(framebuffers.size()), framebuffers.data());
+		assert_opengl_no_error();
+	}
+}
+
+void context::enable_batching(bool enable)
+{
+	if (enable == this->is_batching_enabled()) {
+		return;
+	}
+
+	if (enable) {
+		this->batch = std::make_unique<batcher>();
+	} else {
+		this->batch->flush();
+		this->batch.reset();
+	}
+}
+
+void context::flush_batch()
+{
+	if (this->batch) {
+		this->batch->flush();
+	}
+}
+
+void context::enable_deferred_rendering(bool enable)
+{
+	if (enable == this->is_deferred_rendering_enabled()) {
+		return;
+	}
+
+	if (enable) {
+		this->commands = std::make_unique<command_list>(this->state.render, this->state.framebuffer);
+	} else {
+		this->commands->submit(*this);
+		this->commands.reset();
+	}
+}
+
+void context::flush()
+{
+	if (this->commands) {
+		this->commands->submit(*this);
+	}
+	this->flush_batch();
+}
+
+void context::flush_before_uniform_change()
+{
+	if (this->commands && !this->commands->empty() && !this->commands->is_submitting()) {
+		this->commands->submit(*this);
+	}
+	this->flush_batch();
+}
+
+void context::end_frame()
+{
+	this->finish_frame();
+	this->frame_ended = true;
+}
+
+void context::finish_frame()
+{
+	this->flush();
+
+	this->last_frame_stats.draws = this->draw_stats;
+	this->last_frame_stats.texture_bindings = this->texture_binding_stats;
+
+	this->reset_draw_statistics();
+	this->reset_texture_binding_statistics();
+
+	if (this->vertex_stream) {
+		this->vertex_stream->end_frame();
+	}
+	if (this->index_stream) {
+		this->index_stream->end_frame();
+	}
+
+	this->uploads->process();
+
+	this->delete_queued_objects();
+
+	this->budget->end_frame();
+
+	this->names->end_frame();
+}
+
+size_t context::get_internal_buffers_size() const
+{
+	size_t ret = 0;
+
+	if (this->transforms) {
+		ret += transform_buffer::capacity;
+	}
+	if (this->vertex_stream) {
+		ret += this->vertex_stream->capacity;
+	}
+	if (this->index_stream) {
+		ret += this->index_stream->capacity;
+	}
+
+	ret += this->vertex_arena->get_statistics().num_bytes_reserved;
+	ret += this->index_arena->get_statistics().num_bytes_reserved;
+
+	return ret;
+}
+
+stream_buffer& context::get_vertex_stream()
+{
+	if (!this->vertex_stream) {
+		this->vertex_stream = std::make_unique<stream_buffer>(GL_ARRAY_BUFFER, vertex_stream_capacity);
+	}
+	return *this->vertex_stream;
+}
+
+stream_buffer& context::get_index_stream()
+{
+	if (!this->index_stream) {
+		this->index_stream = std::make_unique<stream_buffer>(GL_ELEMENT_ARRAY_BUFFER, index_stream_capacity);
+	}
+	return *this->index_stream;
+}
+
+buffer_arena& context::get_buffer_arena(GLenum target)
+{
+	switch (target) {
+		case GL_ARRAY_BUFFER:
+			return *this->vertex_arena;
+		case GL_ELEMENT_ARRAY_BUFFER:
+			return *this->index_arena;
+		default:
+			throw std::logic_error("context::get_buffer_arena(): unsupported buffer target");
+	}
+}
+
+void context::invalidate()
+{
+	this->state.render.viewport = get_rectangle(GL_VIEWPORT);
+	this->state.render.scissor = get_rectangle(GL_SCISSOR_BOX);
+	this->state.render.scissor_enabled = is_enabled(GL_SCISSOR_TEST);
+	this->state.render.depth_enabled = is_enabled(GL_DEPTH_TEST);
+	this->state.render.depth_write_enabled = get_boolean(GL_DEPTH_WRITEMASK);
+	this->state.render.depth_func = get_enum(GL_DEPTH_FUNC);
+	this->state.render.blend_enabled = is_enabled(GL_BLEND);
+	this->state.render.blend_func = {
+		get_enum(GL_BLEND_SRC_RGB), //
+		get_enum(GL_BLEND_DST_RGB),
+		get_enum(GL_BLEND_SRC_ALPHA),
+		get_enum(GL_BLEND_DST_ALPHA)
+	};
+	this->state.framebuffer = get_enum(GL_FRAMEBUFFER_BINDING);
+	this->state.program = get_enum(GL_CURRENT_PROGRAM);
+
+	this->state.active_texture_unit = get_enum(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+	for (unsigned i = 0; i != this->state.texture_units.size(); ++i) {
+		// OpenGL guarantees that GL_TEXTUREi = GL_TEXTURE0 + i
+		glActiveTexture(GL_TEXTURE0 + i);
+		auto& unit = this->state.texture_units[i];
+		unit.texture_2d = get_enum(GL_TEXTURE_BINDING_2D);
+		unit.texture_cube_map = get_enum(GL_TEXTURE_BINDING_CUBE_MAP);
+	}
+	glActiveTexture(GL_TEXTURE0 + this->state.active_texture_unit);
+	assert_opengl_no_error();
+
+	if (this->transforms) {
+		this->transforms->invalidate();
+	}
+}
+
+const context::render_state& context::get_render_state() const noexcept
+{
+	if (this->commands) {
+		return this->commands->get_render_state();
+	}
+	return this->state.render;
+}
+
+void context::set_render_state(const render_state& rs)
+{
+	if (this->commands) {
+		this->commands->set_render_state(rs);
+		return;
+	}
+	this->apply_render_state(rs);
+}
+
+void context::apply_render_state(const render_state& rs)
+{
+	auto& cur = this->state.render;
+
+	if (!is_equal(cur.viewport, rs.viewport)) {
+		this->flush_batch();
+
+		const auto& r = rs.viewport;
+		glViewport(GLint(r.p.x()), GLint(r.p.y()), GLint(r.d.x()), GLint(r.d.y()));
+		assert_opengl_no_error();
+
+		cur.viewport = r;
+	}
+
+	if (!is_equal(cur.scissor, rs.scissor)) {
+		this->flush_batch();
+
+		const auto& r = rs.scissor;
+		glScissor(GLint(r.p.x()), GLint(r.p.y()), GLint(r.d.x()), GLint(r.d.y()));
+		assert_opengl_no_error();
+
+		cur.scissor = r;
+	}
+
+	if (cur.scissor_enabled != rs.scissor_enabled) {
+		this->flush_batch();
+
+		set_enabled(GL_SCISSOR_TEST, rs.scissor_enabled);
+
+		cur.scissor_enabled = rs.scissor_enabled;
+	}
+
+	if (cur.depth_enabled != rs.depth_enabled) {
+		this->flush_batch();
+
+		set_enabled(GL_DEPTH_TEST, rs.depth_enabled);
+
+		cur.depth_enabled = rs.depth_enabled;
+	}
+
+	if (cur.depth_write_enabled != rs.depth_write_enabled) {
+		this->flush_batch();
+
+		glDepthMask(rs.depth_write_enabled ? GL_TRUE : GL_FALSE);
+		assert_opengl_no_error();
+
+		cur.depth_write_enabled = rs.depth_write_enabled;
+	}
+
+	if (cur.depth_func != rs.depth_func) {
+		this->flush_batch();
+
+		glDepthFunc(rs.depth_func);
+		assert_opengl_no_error();
+
+		cur.depth_func = rs.depth_func;
+	}
+
+	if (cur.blend_enabled != rs.blend_enabled) {
+		this->flush_batch();
+
+		set_enabled(GL_BLEND, rs.blend_enabled);
+
+		cur.blend_enabled = rs.blend_enabled;
+	}
+
+	if (cur.blend_func != rs.blend_func) {
+		this->flush_batch();
+
+		const auto& f = rs.blend_func;
+		glBlendFuncSeparate(f[0], f[1], f[2], f[3]);
+		assert_opengl_no_error();
+
+		cur.blend_func = f;
+	}
+}
+
+void context::set_viewport(const r4::rectangle<uint32_t>& r)
+{
+	auto rs = this->get_render_state();
+	rs.viewport = r;
+	this->set_render_state(rs);
+}
+
+void context::set_scissor(const r4::rectangle<uint32_t>& r)
+{
+	auto rs = this->get_render_state();
+	rs.scissor = r;
+	this->set_render_state(rs);
+}
+
+void context::enable_scissor(bool enable)
+{
+	auto rs = this->get_render_state();
+	rs.scissor_enabled = enable;
+	this->set_render_state(rs);
+}
+
+void context::enable_depth(bool enable)
+{
+	auto rs = this->get_render_state();
+	rs.depth_enabled = enable;
+	this->set_render_state(rs);
+}
+
+void context::enable_blend(bool enable)
+{
+	auto rs = this->get_render_state();
+	rs.blend_enabled = enable;
+	this->set_render_state(rs);
+}
+
+void context::set_blend_func(const blend_func_type& func)
+{
+	auto rs = this->get_render_state();
+	rs.blend_func = func;
+	this->set_render_state(rs);
+}
+
+void context::set_framebuffer(GLuint fbo)
+{
+	if (this->commands) {
+		this->commands->set_framebuffer(fbo);
+		return;
+	}
+	this->bind_framebuffer(fbo);
+}
+
+void context::clear(GLbitfield mask)
+{
+	if ((mask & GL_COLOR_BUFFER_BIT) != 0) {
+		GLuint fbo = this->commands ? this->commands->get_framebuffer() : this->state.framebuffer;
+		if (fbo == this->default_framebuffer) {
+			// a new frame begins, finish the previous one in case end_frame() was not called,
+			// so that the per-frame work is done even without the optional end_frame()
+			if (!this->frame_ended) {
+				this->finish_frame();
+			}
+			this->frame_ended = false;
+		}
+	}
+
+	// Clearing is done at least once per frame, so delete the objects released on other threads here,
+	// not only in the optional end_frame().
+	this->delete_queued_objects();
+
+	if (this->commands) {
+		this->commands->clear(mask);
+		return;
+	}
+
+	this->flush_batch();
+
+	glClear(mask);
+	assert_opengl_no_error();
+}
+
+void context::bind_framebuffer(GLuint fbo)
+{
+	if (this->state.framebuffer == fbo) {
+		return;
+	}
+
+	this->flush_batch();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	assert_opengl_no_error();
+
+	this->state.framebuffer = fbo;
+}
+
+void context::forget_framebuffer(GLuint fbo)
+{
+	// deleting currently bound framebuffer object reverts the binding to zero
+	if (this->state.framebuffer == fbo) {
+		this->flush_batch();
+		this->state.framebuffer = 0;
+	}
+}
+
+void context::set_transform(const r4::matrix4<float>& m)
+{
+	ASSERT(this->transforms)
+
+	if (this->transforms->is_current(m)) {
+		return;
+	}
+
+	this->flush_batch();
+
+	this->transforms->set(m);
+}
+
+void context::use_program(GLuint program)
+{
+	if (this->state.program == program) {
+		return;
+	}
+
+	this->flush_batch();
+
+	glUseProgram(program);
+	assert_opengl_no_error();
+
+	this->state.program = program;
+}
+
+void context::forget_program(GLuint program)
+{
+	if (this->state.program == program) {
+		this->use_program(0);
+	}
+}
+
+GLuint& context::get_texture_binding(unsigned unit_num, GLenum target)
+{
+	if (unit_num >= this->state.texture_units.size()) {
+		// texture units which were not used so far have no textures bound
+		this->state.texture_units.resize(unit_num + 1);
+	}
+
+	auto& unit = this->state.texture_units[unit_num];
+
+	switch (target) {
+		case GL_TEXTURE_2D:
+			return unit.texture_2d;
+		case GL_TEXTURE_CUBE_MAP:
+			return unit.texture_cube_map;
+		default:
+			throw std::logic_error("context::get_texture_binding(): unsupported texture target");
+	}
+}
+
+void context::set_active_texture_unit(unsigned unit_num)
+{
+	if (this->state.active_texture_unit == unit_num) {
+		return;
+	}
+
+	// OpenGL guarantees that GL_TEXTUREi = GL_TEXTURE0 + i
+	glActiveTexture(GL_TEXTURE0 + unit_num);
+	assert_opengl_no_error();
+
+	this->state.active_texture_unit = unit_num;
+}
+
+void context::bind_texture(unsigned unit_num, GLenum target, GLuint texture)
+{
+	this->set_active_texture_unit(unit_num);
+
+	auto& bound = this->get_texture_binding(unit_num, target);
+	if (bound == texture) {
+		++this->texture_binding_stats.num_skipped;
+		return;
+	}
+
+	this->flush_batch();
+
+	glBindTexture(target, texture);
+	assert_opengl_no_error();
+
+	bound = texture;
+	++this->texture_binding_stats.num_issued;
+}
+
+void context::forget_texture(GLuint texture)
+{
+	for (auto& unit : this->state.texture_units) {
+		if (unit.texture_2d == texture || unit.texture_cube_map == texture) {
+			// the texture is possibly used by the pending batch
+			this->flush_batch();
+			break;
+		}
+	}
+
+	for (auto& unit : this->state.texture_units) {
+		if (unit.texture_2d == texture) {
+			unit.texture_2d = 0;
+		}
+		if (unit.texture_cube_map == texture) {
+			unit.texture_cube_map = 0;
+		}
+	}
+}
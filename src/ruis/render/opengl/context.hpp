@@ -0,0 +1,583 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <r4/matrix.hpp>
+#include <r4/rectangle.hpp>
+
+namespace ruis::render::opengl {
+
+class batcher;
+class buffer_arena;
+class command_list;
+class deletion_queue;
+class memory_budget;
+class name_pool;
+class stream_buffer;
+class texture_upload_queue;
+class transform_buffer;
+
+/**
+ * @brief OpenGL context state tracker.
+ * Keeps CPU-side shadow copy of the OpenGL state which is changed by the renderer.
+ * This allows answering state queries without a round-trip to the driver and
+ * skipping redundant state changes.
+ * All OpenGL state changes tracked by the context must be done through the context,
+ * otherwise the shadow state becomes out of sync. In case some foreign code
+ * changes the OpenGL state, the invalidate() must be called afterwards.
+ */
+class context
+{
+	// thread which the context was created on, the OpenGL context is supposed to be current on that thread
+	const std::thread::id thread_id = std::this_thread::get_id();
+
+	const bool direct_state_access;
+
+	const bool immutable_texture_storage;
+
+public:
+	using blend_func_type = std::array<GLenum, 4>;
+
+	struct texture_binding_statistics {
+		/**
+		 * @brief Number of glBindTexture() calls issued to OpenGL.
+		 */
+		size_t num_issued = 0;
+
+		/**
+		 * @brief Number of texture binds skipped because the texture was already bound.
+		 */
+		size_t num_skipped = 0;
+	};
+
+	struct draw_statistics {
+		/**
+		 * @brief Number of draws requested by the renderer's users.
+		 */
+		size_t num_draws = 0;
+
+		/**
+		 * @brief Number of draws which were merged into batches.
+		 */
+		size_t num_batched_draws = 0;
+
+		/**
+		 * @brief Number of draw calls issued to OpenGL.
+		 */
+		size_t num_draw_calls = 0;
+	};
+
+	/**
+	 * @brief Fixed function state which is set by the renderer.
+	 */
+	struct render_state {
+		r4::rectangle<uint32_t> viewport;
+		r4::rectangle<uint32_t> scissor;
+		bool scissor_enabled = false;
+		bool depth_enabled = false;
+
+		// depth writes and depth function are not changed by the renderer, those are read from OpenGL
+		bool depth_write_enabled = true;
+		GLenum depth_func = GL_LESS;
+
+		bool blend_enabled = false;
+		blend_func_type blend_func{};
+	};
+
+	struct frame_statistics {
+		draw_statistics draws;
+		texture_binding_statistics texture_bindings;
+	};
+
+private:
+	struct state_type {
+		render_state render;
+
+		GLuint framebuffer = 0;
+		GLuint program = 0;
+
+		unsigned active_texture_unit = 0;
+
+		struct texture_unit {
+			GLuint texture_2d = 0;
+			GLuint texture_cube_map = 0;
+		};
+
+		// bound textures of the texture units used so far
+		std::vector<texture_unit> texture_units;
+	} state;
+
+	texture_binding_statistics texture_binding_stats;
+
+	draw_statistics draw_stats;
+
+	frame_statistics last_frame_stats;
+
+	// framebuffer which was bound when the context was created, i.e. the window framebuffer
+	GLuint default_framebuffer = 0;
+
+	// whether the current frame was already finished by end_frame()
+	bool frame_ended = false;
+
+	std::unique_ptr<batcher> batch;
+
+	std::unique_ptr<command_list> commands;
+
+	std::unique_ptr<transform_buffer> transforms;
+
+	std::unique_ptr<stream_buffer> vertex_stream;
+	std::unique_ptr<stream_buffer> index_stream;
+
+	std::unique_ptr<buffer_arena> vertex_arena;
+	std::unique_ptr<buffer_arena> index_arena;
+
+	std::unique_ptr<name_pool> names;
+
+	std::unique_ptr<deletion_queue> deletions;
+
+	std::unique_ptr<memory_budget> budget;
+
+	std::unique_ptr<texture_upload_queue> uploads;
+
+	GLuint& get_texture_binding(unsigned unit_num, GLenum target);
+
+	void set_active_texture_unit(unsigned unit_num);
+
+	void set_render_state(const render_state& rs);
+
+	void finish_frame();
+
+public:
+	/**
+	 * @brief Size of the vertex stream buffer in bytes.
+	 */
+	constexpr static const size_t vertex_stream_capacity = size_t(4) * 1024 * 1024;
+
+	/**
+	 * @brief Size of the index stream buffer in bytes.
+	 */
+	constexpr static const size_t index_stream_capacity = size_t(1) * 1024 * 1024;
+
+	context();
+
+	context(const context&) = delete;
+	context& operator=(const context&) = delete;
+
+	context(context&&) = delete;
+	context& operator=(context&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * In case the context is destroyed on some other thread than the context's thread, the OpenGL objects
+	 * owned by the context and the objects in the deletion queue are not deleted, because no OpenGL calls
+	 * can be done on that thread. Those objects are freed along with the OpenGL context itself.
+	 */
+	~context();
+
+	/**
+	 * @brief Re-read the shadow state from OpenGL.
+	 * Needs to be called in case the OpenGL state was changed by some code
+	 * bypassing the context.
+	 */
+	void invalidate();
+
+	/**
+	 * @brief Get current render state.
+	 * In deferred rendering mode the returned state is the one which was last recorded,
+	 * i.e. it is not yet applied to OpenGL.
+	 * @return current render state.
+	 */
+	const render_state& get_render_state() const noexcept;
+
+	/**
+	 * @brief Apply render state to OpenGL.
+	 * Only the parts of the state which differ from the cached OpenGL state are applied.
+	 * @param rs - render state to apply.
+	 */
+	void apply_render_state(const render_state& rs);
+
+	const r4::rectangle<uint32_t>& get_viewport() const noexcept
+	{
+		return this->get_render_state().viewport;
+	}
+
+	void set_viewport(const r4::rectangle<uint32_t>& r);
+
+	const r4::rectangle<uint32_t>& get_scissor() const noexcept
+	{
+		return this->get_render_state().scissor;
+	}
+
+	void set_scissor(const r4::rectangle<uint32_t>& r);
+
+	bool is_scissor_enabled() const noexcept
+	{
+		return this->get_render_state().scissor_enabled;
+	}
+
+	void enable_scissor(bool enable);
+
+	bool is_depth_enabled() const noexcept
+	{
+		return this->get_render_state().depth_enabled;
+	}
+
+	void enable_depth(bool enable);
+
+	bool is_blend_enabled() const noexcept
+	{
+		return this->get_render_state().blend_enabled;
+	}
+
+	void enable_blend(bool enable);
+
+	const blend_func_type& get_blend_func() const noexcept
+	{
+		return this->get_render_state().blend_func;
+	}
+
+	void set_blend_func(const blend_func_type& func);
+
+	/**
+	 * @brief Set framebuffer to render to.
+	 * In deferred rendering mode the framebuffer change is recorded.
+	 * @param fbo - framebuffer object name.
+	 */
+	void set_framebuffer(GLuint fbo);
+
+	/**
+	 * @brief Clear buffers of the current framebuffer.
+	 * In deferred rendering mode the clear is recorded.
+	 * Also deletes the objects queued for deletion, see delete_queued_objects().
+	 * Clearing the color buffer of the default framebuffer, i.e. the framebuffer which was bound
+	 * when the context was created, begins a new frame. In case the previous frame
+	 * was not finished by end_frame(), it is finished before clearing.
+	 * @param mask - bitwise OR of masks that indicate the buffers to be cleared.
+	 */
+	void clear(GLbitfield mask);
+
+	/**
+	 * @brief Get framebuffer bound to OpenGL.
+	 * @return framebuffer object name.
+	 */
+	GLuint get_framebuffer() const noexcept
+	{
+		return this->state.framebuffer;
+	}
+
+	/**
+	 * @brief Bind framebuffer object.
+	 * Unlike set_framebuffer(), the framebuffer is bound immediately also in deferred rendering mode.
+	 * @param fbo - framebuffer object name.
+	 */
+	void bind_framebuffer(GLuint fbo);
+
+	/**
+	 * @brief Notify the context that the framebuffer object is about to be deleted.
+	 * @param fbo - framebuffer object name.
+	 */
+	void forget_framebuffer(GLuint fbo);
+
+	GLuint get_current_program() const noexcept
+	{
+		return this->state.program;
+	}
+
+	void use_program(GLuint program);
+
+	/**
+	 * @brief Notify the context that the shader program is about to be deleted.
+	 * In case the program is currently in use, it is unbound, so that
+	 * the deleted program name, if reused by OpenGL, would not alias the cached one.
+	 * @param program - shader program name.
+	 */
+	void forget_program(GLuint program);
+
+	/**
+	 * @brief Bind texture to texture unit.
+	 * After the call the given texture unit is the active texture unit,
+	 * so that the texture parameters can be set right after binding the texture.
+	 * @param unit_num - texture unit number.
+	 * @param target - texture target, either GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP.
+	 * @param texture - texture name.
+	 */
+	void bind_texture(unsigned unit_num, GLenum target, GLuint texture);
+
+	/**
+	 * @brief Notify the context that the texture is about to be deleted.
+	 * Deleting a texture unbinds it from all texture units,
+	 * so the texture is removed from the cached texture unit bindings as well,
+	 * this way recycled texture names do not alias the cached ones.
+	 * @param texture - texture name.
+	 */
+	void forget_texture(GLuint texture);
+
+	const texture_binding_statistics& get_texture_binding_statistics() const noexcept
+	{
+		return this->texture_binding_stats;
+	}
+
+	void reset_texture_binding_statistics() noexcept
+	{
+		this->texture_binding_stats = texture_binding_statistics();
+	}
+
+	/**
+	 * @brief Get transformation matrix uniform buffer.
+	 * @return pointer to the transformation matrix uniform buffer if uniform buffers are supported by OpenGL.
+	 * @return nullptr if uniform buffers are not supported, in this case shader programs
+	 *         use classic matrix uniform.
+	 */
+	const transform_buffer* get_transform_buffer() const noexcept
+	{
+		return this->transforms.get();
+	}
+
+	/**
+	 * @brief Set transformation matrix to the uniform buffer.
+	 * Must only be called if uniform buffers are supported, see get_transform_buffer().
+	 * @param m - transformation matrix.
+	 */
+	void set_transform(const r4::matrix4<float>& m);
+
+	/**
+	 * @brief Get ring buffer for transient per-frame vertex data.
+	 * The buffer is created on first call. Since the creation binds the buffer,
+	 * it must not be called while a vertex array object is bound.
+	 * @return vertex stream buffer.
+	 */
+	stream_buffer& get_vertex_stream();
+
+	/**
+	 * @brief Get ring buffer for transient per-frame index data.
+	 * The buffer is created on first call. Since the creation binds the buffer,
+	 * it must not be called while a vertex array object is bound.
+	 * @return index stream buffer.
+	 */
+	stream_buffer& get_index_stream();
+
+	/**
+	 * @brief Get buffer arena for small static buffers.
+	 * @param target - buffer binding target, either GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER.
+	 * @return buffer arena for the given target.
+	 */
+	buffer_arena& get_buffer_arena(GLenum target);
+
+	/**
+	 * @brief Get pool of buffer and texture names.
+	 * @return name pool of this context.
+	 */
+	name_pool& get_name_pool() noexcept
+	{
+		return *this->names;
+	}
+
+	/**
+	 * @brief Check if direct state access is used.
+	 * With direct state access, OpenGL objects are created and modified via their names,
+	 * without binding them, so creating objects does not disturb the current bindings.
+	 * Direct state access is used if it is supported by OpenGL.
+	 * @return true if OpenGL objects are created using direct state access functions.
+	 */
+	bool is_direct_state_access_enabled() const noexcept
+	{
+		return this->direct_state_access;
+	}
+
+	/**
+	 * @brief Check if immutable texture storage is used.
+	 * Immutable texture storage has all its mipmap levels allocated at once with sized internal format,
+	 * and its size and format cannot be changed afterwards. This allows the driver to skip texture
+	 * completeness checks. Immutable texture storage is used if it is supported by OpenGL,
+	 * it is always supported with direct state access.
+	 * @return true if textures are created with immutable storage.
+	 */
+	bool is_immutable_texture_storage_enabled() const noexcept
+	{
+		return this->immutable_texture_storage;
+	}
+
+	/**
+	 * @brief Get queue of asynchronous texture uploads.
+	 * The queued uploads are processed when the frame is finished, see end_frame().
+	 * @return texture upload queue.
+	 */
+	texture_upload_queue& get_texture_upload_queue() noexcept
+	{
+		return *this->uploads;
+	}
+
+	/**
+	 * @brief Get GPU memory budget.
+	 * @return memory budget of this context.
+	 */
+	memory_budget& get_memory_budget() noexcept
+	{
+		return *this->budget;
+	}
+
+	/**
+	 * @brief Get total size of the context's internal buffers.
+	 * Those are the stream buffers, the transform buffer and the buffer arena pages.
+	 * @return size in bytes.
+	 */
+	size_t get_internal_buffers_size() const;
+
+	/**
+	 * @brief Check if the calling thread is the context's thread.
+	 * OpenGL calls can only be done on the context's thread. Objects released on other threads
+	 * must be pushed to the deletion queue instead of being deleted right away, see get_deletion_queue().
+	 * @return true if called on the thread which the context was created on.
+	 */
+	bool is_context_thread() const noexcept
+	{
+		return std::this_thread::get_id() == this->thread_id;
+	}
+
+	/**
+	 * @brief Get queue of objects to delete.
+	 * The queue can be accessed from any thread.
+	 * The queued objects are deleted by clear() and end_frame(), see delete_queued_objects().
+	 * @return deletion queue.
+	 */
+	deletion_queue& get_deletion_queue() noexcept
+	{
+		return *this->deletions;
+	}
+
+	/**
+	 * @brief Delete objects pushed to the deletion queue.
+	 * Objects of the same type are deleted with a single glDelete*() call.
+	 * Must only be called on the context's thread.
+	 */
+	void delete_queued_objects();
+
+	/**
+	 * @brief Enable or disable draw call batching.
+	 * Only vertex arrays created while batching is enabled can be batched,
+	 * because only those keep CPU-side copy of the vertex data.
+	 * @param enable - whether to enable draw call batching.
+	 */
+	void enable_batching(bool enable);
+
+	bool is_batching_enabled() const noexcept
+	{
+		return this->batch != nullptr;
+	}
+
+	/**
+	 * @brief Get draw batcher.
+	 * @return pointer to the draw batcher if batching is enabled.
+	 * @return nullptr if batching is disabled.
+	 */
+	batcher* get_batcher() noexcept
+	{
+		return this->batch.get();
+	}
+
+	/**
+	 * @brief Draw pending batched geometry.
+	 * Called automatically before any tracked OpenGL state change.
+	 */
+	void flush_batch();
+
+	/**
+	 * @brief Execute pending rendering which depends on current shader uniform values.
+	 * Must be called before changing a shader uniform. The uniform values are not recorded
+	 * in deferred rendering mode, so the recorded commands are executed before the change,
+	 * unless the uniform is changed by the executed commands themselves. Also flushes pending batch.
+	 */
+	void flush_before_uniform_change();
+
+	draw_statistics& get_draw_statistics() noexcept
+	{
+		return this->draw_stats;
+	}
+
+	void reset_draw_statistics() noexcept
+	{
+		this->draw_stats = draw_statistics();
+	}
+
+	/**
+	 * @brief Enable or disable deferred rendering.
+	 * In deferred rendering mode the draws and render state changes are recorded
+	 * instead of being executed immediately. The recorded commands are executed by flush().
+	 * Before execution, the draws are reordered to minimize shader program and texture switches,
+	 * see command_list for details.
+	 * All the objects used by the recorded draws (shaders, vertex arrays, textures)
+	 * must stay alive until the recorded commands are executed.
+	 * @param enable - whether to enable deferred rendering.
+	 */
+	void enable_deferred_rendering(bool enable);
+
+	bool is_deferred_rendering_enabled() const noexcept
+	{
+		return this->commands != nullptr;
+	}
+
+	/**
+	 * @brief Get command list.
+	 * @return pointer to the command list if deferred rendering is enabled.
+	 * @return nullptr if deferred rendering is disabled.
+	 */
+	command_list* get_command_list() noexcept
+	{
+		return this->commands.get();
+	}
+
+	/**
+	 * @brief Execute all pending rendering.
+	 * Executes recorded commands, if in deferred rendering mode, and flushes pending batch.
+	 */
+	void flush();
+
+	/**
+	 * @brief Finish the frame.
+	 * Flushes the pending rendering, saves the frame statistics
+	 * and resets statistics counters. Processes asynchronous texture uploads,
+	 * see texture_upload_queue. Deletes the objects released on other threads. Evicts textures
+	 * in case the memory budget is exceeded, see memory_budget. Deletes the pooled buffers
+	 * and textures which were not reused for a while, see name_pool.
+	 * Calling end_frame() is optional. In case it was not called, the frame is finished
+	 * when the color buffer of the default framebuffer is cleared at the beginning of the next frame,
+	 * see clear().
+	 */
+	void end_frame();
+
+	/**
+	 * @brief Get statistics of the last finished frame.
+	 * @return statistics collected during the last finished frame, see end_frame().
+	 */
+	const frame_statistics& get_last_frame_statistics() const noexcept
+	{
+		return this->last_frame_stats;
+	}
+};
+
+} // namespace ruis::render::opengl
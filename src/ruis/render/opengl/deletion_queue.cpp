@@ -0,0 +1,63 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+
+#include <utki/debug.hpp>
+
+using namespace ruis::render::opengl;
+
+deletion_queue::~deletion_queue()
+{
+	ASSERT(this->empty())
+	this->pop_all();
+}
+
+void deletion_queue::push(const object& obj)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+	auto n = new node{.obj = obj, .next = this->head.load(std::memory_order_relaxed)};
+
+	while (!this->head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {
+		// n->next was updated to the current head, try again
+	}
+}
+
+std::vector<deletion_queue::object> deletion_queue::pop_all()
+{
+	auto n = this->head.exchange(nullptr, std::memory_order_acquire);
+
+	std::vector<object> ret;
+	while (n) {
+		ret.push_back(n->obj);
+		auto next = n->next;
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+		delete n;
+		n = next;
+	}
+
+	// the stack pops objects in reverse order
+	std::reverse(ret.begin(), ret.end());
+
+	return ret;
+}
@@ -0,0 +1,121 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "buffer_arena.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Queue of OpenGL objects to delete.
+ * OpenGL objects can only be deleted on the thread where the OpenGL context is current.
+ * Objects released on other threads are pushed to the deletion queue, and the context
+ * deletes them later on its own thread, see context::end_frame().
+ *
+ * The queue is lock-free multiple producers single consumer queue.
+ * Any thread can push to the queue, while only the context's thread pops from it.
+ */
+class deletion_queue
+{
+public:
+	enum class object_type {
+		buffer,
+		arena_slice,
+		texture,
+		vertex_array,
+		framebuffer,
+		program,
+		shader
+	};
+
+	struct object {
+		object_type type;
+
+		/**
+		 * @brief OpenGL object name.
+		 * Unused for arena slices.
+		 */
+		GLuint name = 0;
+
+		/**
+		 * @brief Slice of the buffer arena.
+		 * Used only for arena slices.
+		 */
+		buffer_arena::allocation slice = {};
+
+		/**
+		 * @brief Buffer binding target of the buffer arena.
+		 * Used only for arena slices, see context::get_buffer_arena().
+		 */
+		GLenum target = 0;
+	};
+
+private:
+	struct node {
+		object obj;
+		node* next;
+	};
+
+	// top of the stack of pushed objects
+	std::atomic<node*> head = nullptr;
+
+public:
+	deletion_queue() = default;
+
+	deletion_queue(const deletion_queue&) = delete;
+	deletion_queue& operator=(const deletion_queue&) = delete;
+
+	deletion_queue(deletion_queue&&) = delete;
+	deletion_queue& operator=(deletion_queue&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * The objects remaining in the queue are not deleted, the queue must be drained before.
+	 */
+	~deletion_queue();
+
+	/**
+	 * @brief Push object to the queue.
+	 * Can be called from any thread.
+	 * @param obj - object to delete.
+	 */
+	void push(const object& obj);
+
+	/**
+	 * @brief Pop all objects from the queue.
+	 * Must only be called from the context's thread.
+	 * @return objects in the order they were pushed.
+	 */
+	std::vector<object> pop_all();
+
+	bool empty() const noexcept
+	{
+		return this->head.load(std::memory_order_relaxed) == nullptr;
+	}
+};
+
+} // namespace ruis::render::opengl
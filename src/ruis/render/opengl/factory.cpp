@@ -21,6 +21,11 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "factory.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
 #include <GL/glew.h>
 
 #include "shaders/shader_color.hpp"
@@ -30,18 +35,22 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include "shaders/shader_pos_clr.hpp"
 #include "shaders/shader_pos_tex.hpp"
 
+#include "batcher.hpp"
 #include "frame_buffer.hpp"
 #include "index_buffer.hpp"
+#include "index_optimizer.hpp"
 #include "texture_2d.hpp"
 #include "texture_cube.hpp"
 #include "texture_depth.hpp"
+#include "texture_upload_queue.hpp"
 #include "util.hpp"
 #include "vertex_array.hpp"
 #include "vertex_buffer.hpp"
 
 using namespace ruis::render::opengl;
 
-factory::factory()
+factory::factory() :
+	context(utki::make_shared<opengl::context>())
 {
 	// check that the OpenGL version we have supports shaders
 	if (!GLEW_ARB_vertex_shader || !GLEW_ARB_fragment_shader) {
@@ -65,8 +74,34 @@ utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d(
 	texture_2d_parameters params
 )
 {
-	auto imvar_copy = imvar;
-	return this->create_texture_2d(std::move(imvar_copy), std::move(params));
+	if (!this->top_down_image_textures) {
+		// the image rows have to be flipped, so make a copy of the image
+		auto imvar_copy = imvar;
+		return this->create_texture_2d(std::move(imvar_copy), std::move(params));
+	}
+
+	// the image rows are uploaded as is, without copying and flipping the image
+	return std::visit(
+		[this, &imvar, &params](const auto& im) -> utki::shared_ref<ruis::render::texture_2d> {
+			if constexpr (sizeof(im.pixels().front().front()) != 1) {
+				throw std::logic_error(
+					"factory::create_texture_2d(): "
+					"non-8bit images are not supported"
+				);
+			} else {
+				auto data = im.pixels();
+				return this->create_texture_2d(
+					imvar.get_format(),
+					im.dims(),
+					data.empty() ? utki::span<const uint8_t>()
+								 : utki::make_span(data.front().data(), data.size_bytes()),
+					0, // tightly packed rows
+					std::move(params)
+				);
+			}
+		},
+		imvar.variant
+	);
 }
 
 utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d(
@@ -74,6 +109,11 @@ utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d(
 	texture_2d_parameters params
 )
 {
+	if (this->top_down_image_textures) {
+		// the texel data is uploaded right away, so there is no need to take ownership of the image
+		return this->create_texture_2d(std::as_const(imvar), std::move(params));
+	}
+
 	auto iv = std::move(imvar);
 	return std::visit(
 		[this, &imvar = iv, &params](auto&& im) -> utki::shared_ref<ruis::render::texture_2d> {
@@ -88,7 +128,8 @@ utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d(
 				return this->create_texture_2d_internal(
 					imvar.get_format(),
 					im.dims(),
-					utki::make_span(data.front().data(), data.size_bytes()),
+					data.empty() ? utki::span<const uint8_t>()
+								 : utki::make_span(data.front().data(), data.size_bytes()),
 					std::move(params)
 				);
 			}
@@ -97,6 +138,113 @@ utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d(
 	);
 }
 
+utki::shared_ref<texture_2d> factory::create_texture_2d(
+	rasterimage::format type,
+	rasterimage::dimensioned::dimensions_type dims,
+	utki::span<const uint8_t> data,
+	size_t row_length,
+	texture_2d_parameters params
+)
+{
+	if (row_length == 0) {
+		row_length = dims.x();
+	} else if (row_length < dims.x()) {
+		throw std::invalid_argument("factory::create_texture_2d(): row length is less than texture width");
+	}
+
+	auto num_channels = rasterimage::to_num_channels(type);
+
+	// the last row does not need to be followed by the row padding
+	size_t min_size = dims.y() == 0 ? 0 : ((size_t(dims.y()) - 1) * row_length + dims.x()) * num_channels;
+	if (data.size() < min_size) {
+		throw std::invalid_argument("factory::create_texture_2d(): texel data is too small");
+	}
+
+	auto tex = utki::make_shared<texture_2d>(
+		this->context,
+		type,
+		dims,
+		utki::span<const uint8_t>(),
+		std::move(params),
+		true // rows are top to bottom
+	);
+
+	if (min_size != 0) {
+		tex.get().write_pixels(data.data(), row_length);
+	}
+
+	return tex;
+}
+
+utki::shared_ref<texture_2d> factory::create_texture_2d_async(
+	rasterimage::image_variant&& imvar,
+	texture_2d_parameters params
+)
+{
+	auto iv = std::move(imvar);
+	auto tex = std::visit(
+		[this, &imvar = iv, &params](auto&& im) -> utki::shared_ref<texture_2d> {
+			if constexpr (sizeof(im.pixels().front().front()) != 1) {
+				throw std::logic_error(
+					"factory::create_texture_2d_async(): "
+					"non-8bit images are not supported"
+				);
+			} else {
+				if (!this->top_down_image_textures) {
+					im.span().flip_vertical();
+				}
+				return utki::make_shared<texture_2d>(
+					this->context,
+					imvar.get_format(),
+					im.dims(),
+					utki::span<const uint8_t>(),
+					std::move(params),
+					this->top_down_image_textures
+				);
+			}
+		},
+		iv.variant
+	);
+
+	this->context.get().get_texture_upload_queue().push(tex.to_shared_ptr(), std::move(iv));
+
+	return tex;
+}
+
+utki::shared_ref<texture_2d> factory::create_dynamic_texture_2d(
+	rasterimage::format type,
+	rasterimage::dimensioned::dimensions_type dims,
+	texture_2d_parameters params
+)
+{
+	return utki::make_shared<texture_2d>(
+		this->context,
+		type,
+		dims,
+		utki::span<const uint8_t>(),
+		std::move(params),
+		true // rows are top to bottom
+	);
+}
+
+utki::shared_ref<texture_2d> factory::create_evictable_texture_2d(
+	rasterimage::image_variant&& imvar,
+	texture_2d_parameters params
+)
+{
+	return utki::make_shared<texture_2d>(this->context, std::move(imvar), std::move(params));
+}
+
+utki::shared_ref<texture_atlas> factory::create_texture_atlas(
+	rasterimage::format type,
+	r4::vector2<uint32_t> page_dims,
+	texture_2d_parameters params,
+	uint32_t padding
+)
+{
+	return utki::make_shared<texture_atlas>(this->context, type, page_dims, std::move(params), padding);
+}
+
 utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d_internal(
 	rasterimage::format type,
 	rasterimage::dimensioned::dimensions_type dims,
@@ -105,7 +253,8 @@ utki::shared_ref<ruis::render::texture_2d> factory::create_texture_2d_internal(
 )
 {
 	return utki::make_shared<texture_2d>(
-		type, //
+		this->context,
+		type,
 		dims,
 		data,
 		params
@@ -116,7 +265,7 @@ utki::shared_ref<ruis::render::texture_depth> factory::create_texture_depth(
 	rasterimage::dimensioned::dimensions_type dims
 )
 {
-	return utki::make_shared<texture_depth>(dims);
+	return utki::make_shared<texture_depth>(this->context, dims);
 }
 
 utki::shared_ref<ruis::render::texture_cube> factory::create_texture_cube(
@@ -166,33 +315,33 @@ utki::shared_ref<ruis::render::texture_cube> factory::create_texture_cube(
 		++face;
 	}
 
-	return utki::make_shared<texture_cube>(faces);
+	return utki::make_shared<texture_cube>(this->context, faces);
 }
 
 utki::shared_ref<ruis::render::vertex_buffer> factory::create_vertex_buffer(
 	utki::span<const r4::vector4<float>> vertices
 )
 {
-	return utki::make_shared<vertex_buffer>(vertices);
+	return this->create_vertex_buffer(vertices, buffer_usage::static_draw);
 }
 
 utki::shared_ref<ruis::render::vertex_buffer> factory::create_vertex_buffer(
 	utki::span<const r4::vector3<float>> vertices
 )
 {
-	return utki::make_shared<vertex_buffer>(vertices);
+	return this->create_vertex_buffer(vertices, buffer_usage::static_draw);
 }
 
 utki::shared_ref<ruis::render::vertex_buffer> factory::create_vertex_buffer(
 	utki::span<const r4::vector2<float>> vertices
 )
 {
-	return utki::make_shared<vertex_buffer>(vertices);
+	return this->create_vertex_buffer(vertices, buffer_usage::static_draw);
 }
 
 utki::shared_ref<ruis::render::vertex_buffer> factory::create_vertex_buffer(utki::span<const float> vertices)
 {
-	return utki::make_shared<vertex_buffer>(vertices);
+	return this->create_vertex_buffer(vertices, buffer_usage::static_draw);
 }
 
 utki::shared_ref<ruis::render::vertex_array> factory::create_vertex_array(
@@ -202,7 +351,8 @@ utki::shared_ref<ruis::render::vertex_array> factory::create_vertex_array(
 )
 {
 	return utki::make_shared<vertex_array>(
-		std::move(buffers), //
+		this->context, //
+		std::move(buffers),
 		std::move(indices),
 		mode
 	);
@@ -210,32 +360,255 @@ utki::shared_ref<ruis::render::vertex_array> factory::create_vertex_array(
 
 utki::shared_ref<ruis::render::index_buffer> factory::create_index_buffer(utki::span<const uint16_t> indices)
 {
-	return utki::make_shared<index_buffer>(indices);
+	return this->create_index_buffer(indices, buffer_usage::static_draw);
 }
 
 utki::shared_ref<ruis::render::index_buffer> factory::create_index_buffer(utki::span<const uint32_t> indices)
 {
-	return utki::make_shared<index_buffer>(indices);
+	return this->create_index_buffer(indices, buffer_usage::static_draw);
+}
+
+utki::shared_ref<const index_buffer> factory::get_quad_index_buffer(size_t num_quads)
+{
+	constexpr auto num_quad_vertices = 4;
+	constexpr auto num_quad_indices = 6;
+
+	size_t capacity = this->quad_indices ? size_t(this->quad_indices->elements_count) / num_quad_indices : 0;
+
+	if (this->quad_indices && num_quads <= capacity) {
+		return utki::shared_ref<const index_buffer>(this->quad_indices);
+	}
+
+	constexpr size_t min_capacity = 256;
+	constexpr size_t max_16_bit_capacity = (size_t(std::numeric_limits<uint16_t>::max()) + 1) / num_quad_vertices;
+
+	// grow exponentially, but stay with 16-bit indices as long as possible
+	capacity = std::max({num_quads, 2 * capacity, min_capacity});
+	if (num_quads <= max_16_bit_capacity) {
+		capacity = std::min(capacity, max_16_bit_capacity);
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve(capacity * num_quad_indices);
+	for (uint32_t i = 0; i != capacity * num_quad_vertices; i += num_quad_vertices) {
+		indices.insert(indices.end(), {i, i + 1, i + 2, i, i + 2, i + 3});
+	}
+
+	// keep indices for batching, otherwise draws using the shared index buffer could not be batched
+	bool keep_data = this->context.get().is_batching_enabled();
+
+	if (capacity <= max_16_bit_capacity) {
+		std::vector<uint16_t> indices_16(indices.begin(), indices.end());
+		this->quad_indices = std::make_shared<index_buffer>(this->context, indices_16, keep_data);
+	} else {
+		this->quad_indices = std::make_shared<index_buffer>(this->context, indices, keep_data);
+	}
+
+	return utki::shared_ref<const index_buffer>(this->quad_indices);
+}
+
+utki::shared_ref<vertex_array> factory::create_quad_vertex_array(
+	std::vector<utki::shared_ref<const ruis::render::vertex_buffer>> buffers
+)
+{
+	if (buffers.empty()) {
+		throw std::invalid_argument("factory::create_quad_vertex_array(): no vertex buffers given");
+	}
+
+	size_t num_vertices = [&buffers]() {
+		const auto& vbo = buffers.front().get();
+		if (auto interleaved = dynamic_cast<const interleaved_vertex_buffer*>(&vbo)) {
+			return interleaved->num_vertices;
+		}
+		ASSERT(dynamic_cast<const vertex_buffer*>(&vbo))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		return static_cast<const vertex_buffer&>(vbo).num_vertices;
+	}();
+
+	constexpr auto num_quad_vertices = 4;
+	constexpr auto num_quad_indices = 6;
+
+	if (num_vertices % num_quad_vertices != 0) {
+		throw std::invalid_argument("factory::create_quad_vertex_array(): number of vertices is not a multiple of 4");
+	}
+
+	auto num_quads = num_vertices / num_quad_vertices;
+
+	return utki::make_shared<vertex_array>(
+		this->context,
+		std::move(buffers),
+		this->get_quad_index_buffer(num_quads),
+		ruis::render::vertex_array::mode::triangles,
+		GLsizei(num_quads * num_quad_indices)
+	);
+}
+
+utki::shared_ref<vertex_buffer> factory::create_vertex_buffer(
+	utki::span<const r4::vector4<float>> vertices,
+	buffer_usage usage,
+	vertex_format format
+)
+{
+	return utki::make_shared<vertex_buffer>(
+		this->context,
+		vertices,
+		this->keep_vertex_data(vertices.size()),
+		usage,
+		format
+	);
+}
+
+utki::shared_ref<vertex_buffer> factory::create_vertex_buffer(
+	utki::span<const r4::vector3<float>> vertices,
+	buffer_usage usage,
+	vertex_format format
+)
+{
+	return utki::make_shared<vertex_buffer>(
+		this->context,
+		vertices,
+		this->keep_vertex_data(vertices.size()),
+		usage,
+		format
+	);
+}
+
+utki::shared_ref<vertex_buffer> factory::create_vertex_buffer(
+	utki::span<const r4::vector2<float>> vertices,
+	buffer_usage usage,
+	vertex_format format
+)
+{
+	return utki::make_shared<vertex_buffer>(
+		this->context,
+		vertices,
+		this->keep_vertex_data(vertices.size()),
+		usage,
+		format
+	);
+}
+
+utki::shared_ref<vertex_buffer> factory::create_vertex_buffer(
+	utki::span<const float> vertices,
+	buffer_usage usage,
+	vertex_format format
+)
+{
+	return utki::make_shared<vertex_buffer>(
+		this->context,
+		vertices,
+		this->keep_vertex_data(vertices.size()),
+		usage,
+		format
+	);
+}
+
+utki::shared_ref<interleaved_vertex_buffer> factory::create_interleaved_vertex_buffer(
+	utki::span<const uint8_t> data,
+	vertex_layout layout,
+	buffer_usage usage
+)
+{
+	return utki::make_shared<interleaved_vertex_buffer>(this->context, data, std::move(layout), usage);
+}
+
+utki::shared_ref<index_buffer> factory::create_index_buffer(utki::span<const uint16_t> indices, buffer_usage usage)
+{
+	// each vertex is used by several triangles, so allow more indices than vertices
+	constexpr auto max_indices_per_vertex = 3;
+	return utki::make_shared<index_buffer>(
+		this->context,
+		indices,
+		this->keep_vertex_data(indices.size() / max_indices_per_vertex),
+		usage
+	);
+}
+
+utki::shared_ref<index_buffer> factory::create_index_buffer(utki::span<const uint32_t> indices, buffer_usage usage)
+{
+	// each vertex is used by several triangles, so allow more indices than vertices
+	constexpr auto max_indices_per_vertex = 3;
+	return utki::make_shared<index_buffer>(
+		this->context,
+		indices,
+		this->keep_vertex_data(indices.size() / max_indices_per_vertex),
+		usage
+	);
+}
+
+utki::shared_ref<index_buffer> factory::create_optimized_index_buffer(
+	utki::span<const uint32_t> indices,
+	ruis::render::vertex_array::mode mode,
+	buffer_usage usage
+)
+{
+	std::vector<uint32_t> reordered;
+	if (mode == ruis::render::vertex_array::mode::triangles) {
+		reordered = optimize_vertex_cache(indices);
+		indices = reordered;
+	}
+
+	bool fits_16_bit = std::all_of(indices.begin(), indices.end(), [](auto i) {
+		return i <= std::numeric_limits<uint16_t>::max();
+	});
+
+	if (!fits_16_bit) {
+		return this->create_index_buffer(indices, usage);
+	}
+
+	std::vector<uint16_t> narrowed(indices.begin(), indices.end());
+	return this->create_index_buffer(utki::make_span(std::as_const(narrowed)), usage);
+}
+
+bool factory::keep_vertex_data(size_t num_vertices) const noexcept
+{
+	return this->context.get().is_batching_enabled() && num_vertices <= batcher::max_vertices_per_draw;
 }
 
 std::unique_ptr<ruis::render::factory::shaders> factory::create_shaders()
 {
 	auto ret = std::make_unique<ruis::render::factory::shaders>();
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->pos_tex = std::make_unique<shader_pos_tex>();
+	ret->pos_tex = std::make_unique<shader_pos_tex>(this->context);
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->color_pos = std::make_unique<shader_color>();
+	ret->color_pos = std::make_unique<shader_color>(this->context);
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->pos_clr = std::make_unique<shader_pos_clr>();
+	ret->pos_clr = std::make_unique<shader_pos_clr>(this->context);
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->color_pos_tex = std::make_unique<shader_color_pos_tex>();
+	ret->color_pos_tex = std::make_unique<shader_color_pos_tex>(this->context);
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->color_pos_tex_alpha = std::make_unique<shader_color_pos_tex_alpha>();
+	ret->color_pos_tex_alpha = std::make_unique<shader_color_pos_tex_alpha>(this->context);
 	// NOLINTNEXTLINE(bugprone-unused-return-value, "false positive")
-	ret->color_pos_lum = std::make_unique<shader_color_pos_lum>();
+	ret->color_pos_lum = std::make_unique<shader_color_pos_lum>(this->context);
+	return ret;
+}
+
+std::unique_ptr<factory::instanced_shaders> factory::create_instanced_shaders()
+{
+	auto ret = std::make_unique<instanced_shaders>();
+	ret->color_pos = std::make_unique<shader_color_instanced>(this->context);
+	ret->pos_tex = std::make_unique<shader_pos_tex_instanced>(this->context);
 	return ret;
 }
 
+utki::shared_ref<geometry_pool> factory::create_geometry_pool(
+	std::vector<GLint> attribute_components,
+	GLenum index_type,
+	ruis::render::vertex_array::mode rendering_mode,
+	size_t max_vertices,
+	size_t max_indices
+)
+{
+	return utki::make_shared<geometry_pool>(
+		this->context,
+		std::move(attribute_components),
+		index_type,
+		rendering_mode,
+		max_vertices,
+		max_indices
+	);
+}
+
 utki::shared_ref<ruis::render::frame_buffer> factory::create_framebuffer( //
 	std::shared_ptr<ruis::render::texture_2d> color,
 	std::shared_ptr<ruis::render::texture_depth> depth,
@@ -243,6 +616,7 @@ utki::shared_ref<ruis::render::frame_buffer> factory::create_framebuffer( //
 )
 {
 	return utki::make_shared<frame_buffer>( //
+		this->context,
 		std::move(color),
 		std::move(depth),
 		std::move(stencil)
@@ -22,12 +22,29 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <ruis/render/factory.hpp>
+#include <utki/shared_ref.hpp>
+
+#include "context.hpp"
+#include "geometry_pool.hpp"
+#include "index_buffer.hpp"
+#include "interleaved_vertex_buffer.hpp"
+#include "texture_2d.hpp"
+#include "texture_atlas.hpp"
+#include "shaders/shader_color_instanced.hpp"
+#include "shaders/shader_pos_tex_instanced.hpp"
+#include "vertex_array.hpp"
+#include "vertex_buffer.hpp"
 
 namespace ruis::render::opengl {
 
 class factory : public ruis::render::factory
 {
+	// shared quad list index buffer, see get_quad_index_buffer()
+	std::shared_ptr<const index_buffer> quad_indices;
+
 public:
+	const utki::shared_ref<opengl::context> context;
+
 	factory();
 
 	factory(const factory&) = delete;
@@ -54,6 +71,108 @@ public:
 		texture_2d_parameters params
 	) override;
 
+	/**
+	 * @brief Enable or disable uploading image textures without flipping.
+	 * By default, the rows of the images passed to create_texture_2d() and create_texture_2d_async()
+	 * are flipped before upload, so that the first row of the texel data is the bottom row of the texture.
+	 * When enabled, the images are uploaded as is, without copying and flipping the rows, so the textures
+	 * are top-down, see opengl_texture::top_down. The built-in shaders draw top-down textures correctly,
+	 * while custom shaders have to take the "texture0_top_down" uniform into account, see shader_base::apply(),
+	 * otherwise those textures are drawn upside down.
+	 * Disabled by default.
+	 * @param enable - whether to enable uploading image textures without flipping.
+	 */
+	void enable_top_down_image_textures(bool enable) noexcept
+	{
+		this->top_down_image_textures = enable;
+	}
+
+	/**
+	 * @brief Create texture from borrowed texel data.
+	 * The texel data is uploaded as is, without copying or flipping the rows. The first row of the data
+	 * is the top row of the texture, texturing shaders take this into account, see opengl_texture::top_down.
+	 * @param type - texel data format.
+	 * @param dims - texture dimensions.
+	 * @param data - 8-bit per channel texel data.
+	 * @param row_length - number of pixels from the beginning of one row of the data to the beginning of the next row.
+	 *        Allows creating texture from a sub-rectangle of a bigger image without repacking it, in this case
+	 *        the data starts at the top left pixel of the sub-rectangle. 0 means the rows are tightly packed.
+	 * @param params - texture parameters.
+	 * @return texture.
+	 * @throw std::invalid_argument - if the row length is less than texture width or the data is too small.
+	 */
+	utki::shared_ref<texture_2d> create_texture_2d(
+		rasterimage::format type,
+		rasterimage::dimensioned::dimensions_type dims,
+		utki::span<const uint8_t> data,
+		size_t row_length,
+		texture_2d_parameters params
+	);
+
+	/**
+	 * @brief Create texture with asynchronously uploaded texel data.
+	 * The texture is returned right away, while its texel data is uploaded during
+	 * the following frames, see texture_upload_queue. The uploads are processed when the frame is finished,
+	 * see context::end_frame().
+	 * Until the upload is finished, the texture contents are undefined, see texture_2d::is_ready().
+	 * The image rows are flipped unless top-down image textures are enabled, see enable_top_down_image_textures().
+	 * @param imvar - image to create the texture from.
+	 * @param params - texture parameters.
+	 * @return texture.
+	 */
+	utki::shared_ref<texture_2d> create_texture_2d_async(
+		rasterimage::image_variant&& imvar,
+		texture_2d_parameters params
+	);
+
+	/**
+	 * @brief Create texture which is intended for frequent updates of its contents.
+	 * The texture storage is allocated once and its contents are supposed to be changed
+	 * in place with texture_2d::update() instead of re-creating the texture on every change.
+	 * The texture rows are top to bottom, so the update regions are in image coordinates.
+	 * Initial contents of the texture are undefined.
+	 * @param type - texture format.
+	 * @param dims - texture dimensions.
+	 * @param params - texture parameters.
+	 * @return texture.
+	 */
+	utki::shared_ref<texture_2d> create_dynamic_texture_2d(
+		rasterimage::format type,
+		rasterimage::dimensioned::dimensions_type dims,
+		texture_2d_parameters params
+	);
+
+	/**
+	 * @brief Create evictable texture.
+	 * The texture keeps the image, so that its storage can be evicted when the GPU memory budget
+	 * is exceeded and restored when the texture is bound next time, see memory_budget.
+	 * The image rows are uploaded top to bottom.
+	 * @param imvar - image to create the texture from.
+	 * @param params - texture parameters.
+	 * @return texture.
+	 * @throw std::invalid_argument - if the image is not 8 bits per channel.
+	 */
+	utki::shared_ref<texture_2d> create_evictable_texture_2d(
+		rasterimage::image_variant&& imvar,
+		texture_2d_parameters params
+	);
+
+	/**
+	 * @brief Create texture atlas.
+	 * @param type - pixel format of the atlas pages.
+	 * @param page_dims - dimensions of the atlas pages.
+	 * @param params - texture parameters of the atlas pages, mipmapping must be disabled.
+	 * @param padding - number of texels to surround each image with.
+	 * @return texture atlas.
+	 * @throw std::invalid_argument - if the page dimensions are zero, the padding is too big or mipmapping is enabled.
+	 */
+	utki::shared_ref<texture_atlas> create_texture_atlas(
+		rasterimage::format type,
+		r4::vector2<uint32_t> page_dims,
+		texture_2d_parameters params,
+		uint32_t padding = 1
+	);
+
 	utki::shared_ref<ruis::render::texture_depth> create_texture_depth(
 		rasterimage::dimensioned::dimensions_type dims
 	) override;
@@ -85,8 +204,163 @@ public:
 		ruis::render::vertex_array::mode mode
 	) override;
 
+	/**
+	 * @brief Create vertex buffer with usage hint.
+	 * Unlike the ruis::render::factory's vertex buffer creation methods, returns
+	 * OpenGL vertex buffer, which can be updated, see vertex_buffer::update().
+	 * This allows reusing the vertex buffer and vertex arrays using it for animated geometry.
+	 * @param vertices - initial vertex data. Also determines the vertex buffer size.
+	 * @param usage - buffer usage hint. For animated geometry it is buffer_usage::dynamic_draw.
+	 * @param format - storage format of the vertex components, see vertex_format.
+	 *                 E.g. colors can be stored as vertex_format::uint8_normalized.
+	 * @return vertex buffer.
+	 */
+	utki::shared_ref<vertex_buffer> create_vertex_buffer(
+		utki::span<const r4::vector4<float>> vertices,
+		buffer_usage usage,
+		vertex_format format = vertex_format::float32
+	);
+	utki::shared_ref<vertex_buffer> create_vertex_buffer(
+		utki::span<const r4::vector3<float>> vertices,
+		buffer_usage usage,
+		vertex_format format = vertex_format::float32
+	);
+	utki::shared_ref<vertex_buffer> create_vertex_buffer(
+		utki::span<const r4::vector2<float>> vertices,
+		buffer_usage usage,
+		vertex_format format = vertex_format::float32
+	);
+	utki::shared_ref<vertex_buffer> create_vertex_buffer(
+		utki::span<const float> vertices,
+		buffer_usage usage,
+		vertex_format format = vertex_format::float32
+	);
+
+	/**
+	 * @brief Create index buffer with usage hint.
+	 * Unlike the ruis::render::factory's index buffer creation methods, returns
+	 * OpenGL index buffer, which can be updated, see index_buffer::update().
+	 * @param indices - initial indices. Also determines the index buffer size.
+	 * @param usage - buffer usage hint.
+	 * @return index buffer.
+	 */
+	utki::shared_ref<index_buffer> create_index_buffer(utki::span<const uint16_t> indices, buffer_usage usage);
+	utki::shared_ref<index_buffer> create_index_buffer(utki::span<const uint32_t> indices, buffer_usage usage);
+
+	/**
+	 * @brief Create index buffer with optimized indices.
+	 * The indices are narrowed to 16-bit if all of them fit, this halves the index memory.
+	 * For triangle lists the triangles are reordered for post-transform vertex cache locality,
+	 * see optimize_vertex_cache(). The drawn triangles stay the same, only their order changes,
+	 * so the reordering is only suitable for geometry which does not rely on drawing order, e.g. when
+	 * the triangles do not overlap.
+	 * @param indices - indices.
+	 * @param mode - rendering mode of the vertex arrays the index buffer is going to be used with.
+	 * @param usage - buffer usage hint.
+	 * @return index buffer.
+	 */
+	utki::shared_ref<index_buffer> create_optimized_index_buffer(
+		utki::span<const uint32_t> indices,
+		ruis::render::vertex_array::mode mode,
+		buffer_usage usage = buffer_usage::static_draw
+	);
+
+	/**
+	 * @brief Create interleaved vertex buffer.
+	 * See interleaved_vertex_buffer for details.
+	 * @param data - vertex data.
+	 * @param layout - vertex layout.
+	 * @param usage - buffer usage hint.
+	 * @return interleaved vertex buffer.
+	 */
+	utki::shared_ref<interleaved_vertex_buffer> create_interleaved_vertex_buffer(
+		utki::span<const uint8_t> data,
+		vertex_layout layout,
+		buffer_usage usage = buffer_usage::static_draw
+	);
+
+	/**
+	 * @brief Create interleaved vertex buffer from array of vertex structures.
+	 * @param vertices - vertices.
+	 * @param layout - vertex layout, the stride is normally sizeof(vertex_type).
+	 * @param usage - buffer usage hint.
+	 * @return interleaved vertex buffer.
+	 */
+	template <typename vertex_type>
+	utki::shared_ref<interleaved_vertex_buffer> create_interleaved_vertex_buffer(
+		utki::span<const vertex_type> vertices,
+		vertex_layout layout,
+		buffer_usage usage = buffer_usage::static_draw
+	)
+	{
+		return this->create_interleaved_vertex_buffer(
+			utki::make_span(
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+				reinterpret_cast<const uint8_t*>(vertices.data()),
+				vertices.size_bytes()
+			),
+			std::move(layout),
+			usage
+		);
+	}
+
+	/**
+	 * @brief Get shared quad list index buffer.
+	 * For each quad of four consecutive vertices the index buffer contains
+	 * indices of two triangles: (0, 1, 2) and (0, 2, 3).
+	 * The index buffer grows on demand, in that case a new bigger index buffer is created,
+	 * while vertex arrays using the old one keep it alive.
+	 * @param num_quads - minimal number of quads the index buffer must have indices for.
+	 * @return quad list index buffer.
+	 */
+	utki::shared_ref<const index_buffer> get_quad_index_buffer(size_t num_quads);
+
+	/**
+	 * @brief Create vertex array of quad list.
+	 * Each four consecutive vertices form a quad, which is drawn as two triangles,
+	 * see get_quad_index_buffer(). The vertex array uses the shared quad list index buffer,
+	 * so no index buffer is created or uploaded.
+	 * @param buffers - vertex buffers.
+	 * @return vertex array with triangles rendering mode.
+	 * @throw std::invalid_argument - if there are no vertex buffers or number of vertices is not a multiple of 4.
+	 */
+	utki::shared_ref<vertex_array> create_quad_vertex_array(
+		std::vector<utki::shared_ref<const ruis::render::vertex_buffer>> buffers
+	);
+
 	std::unique_ptr<shaders> create_shaders() override;
 
+	struct instanced_shaders {
+		std::unique_ptr<shader_color_instanced> color_pos;
+		std::unique_ptr<shader_pos_tex_instanced> pos_tex;
+	};
+
+	/**
+	 * @brief Create shaders for instanced rendering.
+	 * The instanced shaders render many instances of the same vertex array with a single draw call.
+	 * On OpenGL without instanced arrays support the instances are drawn one by one.
+	 * @return instanced shaders.
+	 */
+	std::unique_ptr<instanced_shaders> create_instanced_shaders();
+
+	/**
+	 * @brief Create geometry pool.
+	 * See geometry_pool for details.
+	 * @param attribute_components - number of float components of each vertex attribute.
+	 * @param index_type - index type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+	 * @param rendering_mode - rendering mode of the vertex arrays stored in the pool.
+	 * @param max_vertices - vertex capacity of the pool.
+	 * @param max_indices - index capacity of the pool.
+	 * @return geometry pool.
+	 */
+	utki::shared_ref<geometry_pool> create_geometry_pool(
+		std::vector<GLint> attribute_components,
+		GLenum index_type,
+		ruis::render::vertex_array::mode rendering_mode,
+		size_t max_vertices,
+		size_t max_indices
+	);
+
 	utki::shared_ref<ruis::render::frame_buffer> create_framebuffer( //
 		std::shared_ptr<ruis::render::texture_2d> color,
 		std::shared_ptr<ruis::render::texture_depth> depth,
@@ -94,6 +368,11 @@ public:
 	) override;
 
 private:
+	bool top_down_image_textures = false;
+
+	// whether to keep CPU-side copy of vertex data for batching
+	bool keep_vertex_data(size_t num_vertices) const noexcept;
+
 	utki::shared_ref<ruis::render::texture_2d> create_texture_2d_internal(
 		rasterimage::format type,
 		rasterimage::dimensioned::dimensions_type dims,
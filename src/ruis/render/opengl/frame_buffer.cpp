@@ -24,6 +24,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <GL/glew.h>
 #include <utki/string.hpp>
 
+#include "deletion_queue.hpp"
 #include "texture_2d.hpp"
 #include "texture_depth.hpp"
 #include "util.hpp"
@@ -31,6 +32,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 using namespace ruis::render::opengl;
 
 frame_buffer::frame_buffer(
+	utki::shared_ref<opengl::context> context,
 	std::shared_ptr<ruis::render::texture_2d> color,
 	std::shared_ptr<ruis::render::texture_depth> depth,
 	std::shared_ptr<ruis::render::texture_stencil> stencil
@@ -39,19 +41,20 @@ frame_buffer::frame_buffer(
 		std::move(color),
 		std::move(depth),
 		std::move(stencil)
-	)
+	),
+	context(std::move(context))
 {
+	if (this->context.get().is_direct_state_access_enabled()) {
+		this->init_using_direct_state_access();
+		return;
+	}
+
 	glGenFramebuffers(1, &this->fbo);
 	assert_opengl_no_error();
 
-	// No need to initialize the variable because it is initialized via
-	// output argument of glGetIntegerv().
-	// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
-	GLint old_fb;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_fb);
+	GLuint old_fb = this->context.get().get_framebuffer();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
-	assert_opengl_no_error();
+	this->context.get().bind_framebuffer(this->fbo);
 
 	if (this->color) {
 		ASSERT(dynamic_cast<texture_2d*>(this->color.get()))
@@ -88,12 +91,58 @@ frame_buffer::frame_buffer(
 		}
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, old_fb);
+	this->context.get().bind_framebuffer(old_fb);
+}
+
+void frame_buffer::init_using_direct_state_access()
+{
+	ASSERT(this->context.get().is_direct_state_access_enabled())
+
+	glCreateFramebuffers(1, &this->fbo);
+	assert_opengl_no_error();
+
+	if (this->color) {
+		ASSERT(dynamic_cast<texture_2d*>(this->color.get()))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		auto& tex = static_cast<texture_2d&>(*this->color);
+
+		glNamedFramebufferTexture(this->fbo, GL_COLOR_ATTACHMENT0, tex.tex, 0);
+		assert_opengl_no_error();
+	}
+
+	if (this->depth) {
+		ASSERT(dynamic_cast<texture_depth*>(this->depth.get()))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		auto& tex = static_cast<texture_depth&>(*this->depth);
+
+		glNamedFramebufferTexture(this->fbo, GL_DEPTH_ATTACHMENT, tex.tex, 0);
+		assert_opengl_no_error();
+	}
+
+	if (this->stencil) {
+		throw std::logic_error("frame_buffer(): OpenGL stencil texture support is not implemented");
+	}
+
+	GLenum status = glCheckNamedFramebufferStatus(this->fbo, GL_FRAMEBUFFER);
 	assert_opengl_no_error();
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error(
+			utki::cat("frame_buffer(): OpenGL framebuffer is incomplete: status = ", unsigned(status))
+		);
+	}
 }
 
 frame_buffer::~frame_buffer()
 {
+	if (!this->context.get().is_context_thread()) {
+		this->context.get().get_deletion_queue().push({
+			.type = deletion_queue::object_type::framebuffer,
+			.name = this->fbo //
+		});
+		return;
+	}
+
+	this->context.get().forget_framebuffer(this->fbo);
 	glDeleteFramebuffers(1, &this->fbo);
 	assert_opengl_no_error();
 }
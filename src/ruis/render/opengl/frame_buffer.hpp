@@ -23,15 +23,21 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <GL/glew.h>
 #include <ruis/render/frame_buffer.hpp>
+#include <utki/shared_ref.hpp>
+
+#include "context.hpp"
 
 namespace ruis::render::opengl {
 
 class frame_buffer : public ruis::render::frame_buffer
 {
+	const utki::shared_ref<opengl::context> context;
+
 public:
 	GLuint fbo = 0;
 
 	frame_buffer( //
+		utki::shared_ref<opengl::context> context,
 		std::shared_ptr<ruis::render::texture_2d> color,
 		std::shared_ptr<ruis::render::texture_depth> depth,
 		std::shared_ptr<ruis::render::texture_stencil> stencil
@@ -46,6 +52,8 @@ public:
 	~frame_buffer() override;
 
 private:
+	// attaches the textures without binding the framebuffer
+	void init_using_direct_state_access();
 };
 
 } // namespace ruis::render::opengl
@@ -0,0 +1,326 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "geometry_pool.hpp"
+
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "deletion_queue.hpp"
+#include "index_buffer.hpp"
+#include "memory_budget.hpp"
+#include "util.hpp"
+#include "vertex_array.hpp"
+#include "vertex_buffer.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+size_t index_size(GLenum index_type)
+{
+	switch (index_type) {
+		case GL_UNSIGNED_SHORT:
+			return sizeof(GLushort);
+		case GL_UNSIGNED_INT:
+			return sizeof(GLuint);
+		default:
+			throw std::invalid_argument("geometry_pool: unsupported index type");
+	}
+}
+
+void copy_buffer(GLuint src, size_t src_offset, GLuint dst, size_t dst_offset, size_t size)
+{
+	glBindBuffer(GL_COPY_READ_BUFFER, src);
+	assert_opengl_no_error();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+	assert_opengl_no_error();
+	glCopyBufferSubData(
+		GL_COPY_READ_BUFFER,
+		GL_COPY_WRITE_BUFFER,
+		GLintptr(src_offset),
+		GLintptr(dst_offset),
+		GLsizeiptr(size)
+	);
+	assert_opengl_no_error();
+}
+} // namespace
+
+bool geometry_pool::is_supported() noexcept
+{
+	return GLEW_ARB_vertex_array_object && GLEW_ARB_copy_buffer && GLEW_ARB_draw_elements_base_vertex;
+}
+
+geometry_pool::geometry_pool(
+	utki::shared_ref<opengl::context> context,
+	std::vector<GLint> attribute_components,
+	GLenum index_type,
+	ruis::render::vertex_array::mode rendering_mode,
+	size_t max_vertices,
+	size_t max_indices
+) :
+	context(std::move(context)),
+	attribute_components(std::move(attribute_components)),
+	index_type(index_type),
+	rendering_mode(rendering_mode),
+	max_vertices(max_vertices),
+	max_indices(max_indices),
+	vao([]() {
+		if (!is_supported()) {
+			throw std::logic_error("geometry_pool: not supported by OpenGL");
+		}
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		glGenVertexArrays(1, &ret);
+		assert_opengl_no_error();
+		return ret;
+	}()),
+	indirect_buffer(this->context.get().get_name_pool().gen_buffer())
+{
+	this->context.get().get_memory_budget().allocate(memory_budget::category::buffer, this->get_storage_size());
+
+	glBindVertexArray(this->vao);
+	assert_opengl_no_error();
+
+	for (unsigned i = 0; i != this->attribute_components.size(); ++i) {
+		GLint num_components = this->attribute_components[i];
+		ASSERT(num_components > 0)
+
+		this->vbos.push_back(this->acquire_buffer(this->get_vertex_buffer_storage(i)));
+
+		glVertexAttribPointer(i, num_components, GL_FLOAT, GL_FALSE, 0, nullptr);
+		assert_opengl_no_error();
+		glEnableVertexAttribArray(i);
+		assert_opengl_no_error();
+	}
+
+	// the index buffer is bound to the vertex array object
+	this->ibo = this->acquire_buffer(this->get_index_buffer_storage());
+
+	glBindVertexArray(0);
+	assert_opengl_no_error();
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	assert_opengl_no_error();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	assert_opengl_no_error();
+}
+
+geometry_pool::~geometry_pool()
+{
+	this->context.get().get_memory_budget().free(memory_budget::category::buffer, this->get_storage_size());
+
+	if (!this->context.get().is_context_thread()) {
+		auto& queue = this->context.get().get_deletion_queue();
+
+		queue.push({
+			.type = deletion_queue::object_type::vertex_array,
+			.name = this->vao //
+		});
+
+		for (auto b : this->vbos) {
+			queue.push({
+				.type = deletion_queue::object_type::buffer,
+				.name = b //
+			});
+		}
+
+		for (auto b : {this->ibo, this->indirect_buffer}) {
+			queue.push({
+				.type = deletion_queue::object_type::buffer,
+				.name = b //
+			});
+		}
+		return;
+	}
+
+	glBindVertexArray(0);
+	assert_opengl_no_error();
+	glDeleteVertexArrays(1, &this->vao);
+	assert_opengl_no_error();
+
+	auto& names = this->context.get().get_name_pool();
+
+	for (unsigned i = 0; i != this->vbos.size(); ++i) {
+		names.recycle_buffer(this->vbos[i], this->get_vertex_buffer_storage(i));
+	}
+	names.recycle_buffer(this->ibo, this->get_index_buffer_storage());
+
+	// the indirect buffer storage changes every frame, so it is not recycled
+	glDeleteBuffers(1, &this->indirect_buffer);
+	assert_opengl_no_error();
+}
+
+name_pool::buffer_storage geometry_pool::get_vertex_buffer_storage(size_t attribute_index) const
+{
+	ASSERT(attribute_index < this->attribute_components.size())
+	return {
+		.target = GL_ARRAY_BUFFER,
+		.size = this->max_vertices * size_t(this->attribute_components[attribute_index]) * sizeof(float),
+		.usage = GL_STATIC_DRAW
+	};
+}
+
+name_pool::buffer_storage geometry_pool::get_index_buffer_storage() const
+{
+	return {
+		.target = GL_ELEMENT_ARRAY_BUFFER,
+		.size = this->max_indices * index_size(this->index_type),
+		.usage = GL_STATIC_DRAW
+	};
+}
+
+size_t geometry_pool::get_storage_size() const
+{
+	size_t ret = this->get_index_buffer_storage().size;
+	for (size_t i = 0; i != this->attribute_components.size(); ++i) {
+		ret += this->get_vertex_buffer_storage(i).size;
+	}
+	return ret;
+}
+
+GLuint geometry_pool::acquire_buffer(const name_pool::buffer_storage& storage)
+{
+	auto& names = this->context.get().get_name_pool();
+
+	GLuint ret = names.acquire_buffer(storage);
+	bool recycled = ret != 0;
+	if (!recycled) {
+		ret = names.gen_buffer();
+	}
+
+	glBindBuffer(storage.target, ret);
+	assert_opengl_no_error();
+
+	if (!recycled) {
+		glBufferData(storage.target, GLsizeiptr(storage.size), nullptr, storage.usage);
+		assert_opengl_no_error();
+	}
+
+	return ret;
+}
+
+bool geometry_pool::has_space_for(const ruis::render::vertex_array& va) const
+{
+	if (va.buffers.empty()) {
+		return true;
+	}
+
+	// interleaved vertex buffers cannot be added to the pool
+	const auto* vbo = dynamic_cast<const vertex_buffer*>(&va.buffers.front().get());
+	if (!vbo) {
+		return false;
+	}
+
+	ASSERT(dynamic_cast<const vertex_array*>(&va))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ogl_va = static_cast<const vertex_array&>(va);
+
+	return this->num_vertices + vbo->num_vertices <= this->max_vertices &&
+		this->num_indices + size_t(ogl_va.num_indices) <= this->max_indices;
+}
+
+geometry_pool::range geometry_pool::add(const ruis::render::vertex_array& va)
+{
+	if (va.rendering_mode != this->rendering_mode) {
+		throw std::invalid_argument("geometry_pool::add(): rendering mode mismatch");
+	}
+
+	if (va.buffers.size() != this->vbos.size()) {
+		throw std::invalid_argument("geometry_pool::add(): number of vertex attributes mismatch");
+	}
+
+	ASSERT(dynamic_cast<const index_buffer*>(&va.indices.get()))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ivbo = static_cast<const index_buffer&>(va.indices.get());
+
+	ASSERT(dynamic_cast<const vertex_array*>(&va))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ogl_va = static_cast<const vertex_array&>(va);
+
+	if (ivbo.element_type != this->index_type) {
+		throw std::invalid_argument("geometry_pool::add(): index type mismatch");
+	}
+
+	size_t va_num_vertices = 0;
+
+	for (unsigned i = 0; i != va.buffers.size(); ++i) {
+		const auto* vbo_ptr = dynamic_cast<const vertex_buffer*>(&va.buffers[i].get());
+		if (!vbo_ptr) {
+			throw std::invalid_argument("geometry_pool::add(): interleaved vertex buffers are not supported");
+		}
+		const auto& vbo = *vbo_ptr;
+
+		if (vbo.num_components != this->attribute_components[i] || vbo.type != GL_FLOAT) {
+			throw std::invalid_argument("geometry_pool::add(): vertex attribute format mismatch");
+		}
+
+		if (i == 0) {
+			va_num_vertices = vbo.num_vertices;
+		} else if (vbo.num_vertices != va_num_vertices) {
+			throw std::invalid_argument("geometry_pool::add(): vertex buffers have different number of vertices");
+		}
+	}
+
+	if (!this->has_space_for(va)) {
+		throw std::length_error("geometry_pool::add(): not enough free space in the pool");
+	}
+
+	for (unsigned i = 0; i != va.buffers.size(); ++i) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		const auto& vbo = static_cast<const vertex_buffer&>(va.buffers[i].get());
+
+		auto vertex_size = size_t(vbo.num_components) * sizeof(float);
+
+		copy_buffer(
+			vbo.buffer,
+			vbo.offset,
+			this->vbos[i],
+			this->num_vertices * vertex_size,
+			vbo.num_vertices * vertex_size
+		);
+	}
+
+	auto idx_size = index_size(this->index_type);
+	copy_buffer(
+		ivbo.buffer,
+		ivbo.offset,
+		this->ibo,
+		this->num_indices * idx_size,
+		size_t(ogl_va.num_indices) * idx_size
+	);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	assert_opengl_no_error();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	assert_opengl_no_error();
+
+	range ret{
+		.first_index = GLuint(this->num_indices),
+		.num_indices = ogl_va.num_indices,
+		.base_vertex = GLint(this->num_vertices)
+	};
+
+	this->num_vertices += va_num_vertices;
+	this->num_indices += size_t(ogl_va.num_indices);
+
+	return ret;
+}
@@ -0,0 +1,155 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <ruis/render/vertex_array.hpp>
+#include <utki/shared_ref.hpp>
+
+#include "context.hpp"
+#include "name_pool.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Pool of geometry stored in shared vertex and index buffers.
+ * Vertex arrays added to the pool are copied into the shared buffers, so that any number of them
+ * can be drawn with a single multi-draw call without switching vertex arrays,
+ * see shader_base::render_multi().
+ * All the vertex arrays added to the pool must have the same vertex layout,
+ * index type and rendering mode, which are given to the pool on construction.
+ * The pool has fixed capacity.
+ */
+class geometry_pool
+{
+	friend class shader_base;
+
+public:
+	/**
+	 * @brief Location of vertex array geometry within the pool.
+	 */
+	struct range {
+		// index of the first index of the range in the shared index buffer
+		GLuint first_index;
+		GLsizei num_indices;
+		GLint base_vertex;
+	};
+
+	const utki::shared_ref<opengl::context> context;
+
+	const std::vector<GLint> attribute_components;
+	const GLenum index_type;
+	const ruis::render::vertex_array::mode rendering_mode;
+
+	const size_t max_vertices;
+	const size_t max_indices;
+
+private:
+	const GLuint vao;
+
+	// vertex and index buffers are set by constructor, those are acquired from the context's name pool
+	std::vector<GLuint> vbos;
+	GLuint ibo = 0;
+
+	// per-frame indirect draw commands buffer
+	const GLuint indirect_buffer;
+
+	size_t num_vertices = 0;
+	size_t num_indices = 0;
+
+	name_pool::buffer_storage get_vertex_buffer_storage(size_t attribute_index) const;
+	name_pool::buffer_storage get_index_buffer_storage() const;
+
+	// size of the vertex and index buffers storage in bytes
+	size_t get_storage_size() const;
+
+	// gets recycled buffer with the storage or creates a new one, leaves the buffer bound to the storage target
+	GLuint acquire_buffer(const name_pool::buffer_storage& storage);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param attribute_components - number of float components of each vertex attribute.
+	 * @param index_type - index type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+	 * @param rendering_mode - rendering mode of the vertex arrays.
+	 * @param max_vertices - vertex capacity of the pool.
+	 * @param max_indices - index capacity of the pool.
+	 */
+	geometry_pool(
+		utki::shared_ref<opengl::context> context,
+		std::vector<GLint> attribute_components,
+		GLenum index_type,
+		ruis::render::vertex_array::mode rendering_mode,
+		size_t max_vertices,
+		size_t max_indices
+	);
+
+	geometry_pool(const geometry_pool&) = delete;
+	geometry_pool& operator=(const geometry_pool&) = delete;
+
+	geometry_pool(geometry_pool&&) = delete;
+	geometry_pool& operator=(geometry_pool&&) = delete;
+
+	~geometry_pool();
+
+	/**
+	 * @brief Check if geometry pools are supported by OpenGL.
+	 * Geometry pools require vertex array objects, buffer to buffer copying
+	 * and draw calls with base vertex.
+	 * @return true if geometry pools are supported.
+	 */
+	static bool is_supported() noexcept;
+
+	/**
+	 * @brief Check if the pool has enough free space for the vertex array.
+	 * @param va - vertex array to check.
+	 * @return true if the vertex array can be added to the pool.
+	 * @return false if there is not enough free space or the vertex array has interleaved vertex buffers.
+	 */
+	bool has_space_for(const ruis::render::vertex_array& va) const;
+
+	/**
+	 * @brief Copy vertex array geometry into the pool.
+	 * The copying is done on GPU side.
+	 * @param va - vertex array to add.
+	 * @return location of the vertex array geometry within the pool.
+	 * @throw std::invalid_argument - if the vertex array layout, index type or rendering mode
+	 *                                does not match the pool, or the vertex array has interleaved vertex buffers.
+	 * @throw std::length_error - if there is not enough free space in the pool.
+	 */
+	range add(const ruis::render::vertex_array& va);
+
+	/**
+	 * @brief Remove all geometry from the pool.
+	 * Previously returned ranges become invalid.
+	 */
+	void clear() noexcept
+	{
+		this->num_vertices = 0;
+		this->num_indices = 0;
+	}
+};
+
+} // namespace ruis::render::opengl
@@ -21,27 +21,102 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "index_buffer.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <GL/glew.h>
 
 #include "util.hpp"
 
 using namespace ruis::render::opengl;
 
-index_buffer::index_buffer(const void* data, size_t size_bytes, size_t size, GLenum element_type) :
-	element_type(element_type),
-	elements_count(GLsizei(size))
+namespace {
+template <typename index_type>
+utki::span<const uint8_t> to_byte_span(utki::span<const index_type> indices)
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffer);
-	assert_opengl_no_error();
-
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(size_bytes), data, GL_STATIC_DRAW);
-	assert_opengl_no_error();
+	return utki::make_span(
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		reinterpret_cast<const uint8_t*>(indices.data()),
+		indices.size_bytes()
+	);
 }
+} // namespace
+
+index_buffer::index_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const uint8_t> data,
+	size_t size,
+	GLenum element_type,
+	std::vector<uint32_t> data_copy,
+	buffer_usage usage
+) :
+	opengl_buffer(std::move(context), GL_ELEMENT_ARRAY_BUFFER, data, usage),
+	element_type(element_type),
+	elements_count(GLsizei(size)),
+	data(std::move(data_copy))
+{}
 
-index_buffer::index_buffer(utki::span<const uint16_t> indices) :
-	index_buffer(indices.data(), indices.size_bytes(), indices.size(), GL_UNSIGNED_SHORT)
+index_buffer::index_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const uint16_t> indices,
+	bool keep_data,
+	buffer_usage usage
+) :
+	index_buffer(
+		std::move(context),
+		to_byte_span(indices),
+		indices.size(),
+		GL_UNSIGNED_SHORT,
+		keep_data ? std::vector<uint32_t>(indices.begin(), indices.end()) : std::vector<uint32_t>(),
+		usage
+	)
 {}
 
-index_buffer::index_buffer(utki::span<const uint32_t> indices) :
-	index_buffer(indices.data(), indices.size_bytes(), indices.size(), GL_UNSIGNED_INT)
+index_buffer::index_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const uint32_t> indices,
+	bool keep_data,
+	buffer_usage usage
+) :
+	index_buffer(
+		std::move(context),
+		to_byte_span(indices),
+		indices.size(),
+		GL_UNSIGNED_INT,
+		keep_data ? std::vector<uint32_t>(indices.begin(), indices.end()) : std::vector<uint32_t>(),
+		usage
+	)
 {}
+
+template <typename index_type>
+void index_buffer::update_internal(utki::span<const index_type> indices, GLenum element_type, size_t offset)
+{
+	if (element_type != this->element_type) {
+		throw std::invalid_argument("index_buffer::update(): index type mismatch");
+	}
+
+	auto size = size_t(this->elements_count);
+
+	if (offset > size || indices.size() > size - offset) {
+		throw std::out_of_range("index_buffer::update(): data does not fit into the buffer");
+	}
+
+	// recorded draws use the current contents of the buffer
+	this->context.get().flush();
+
+	if (!this->data.empty()) {
+		std::copy(indices.begin(), indices.end(), std::next(this->data.begin(), std::ptrdiff_t(offset)));
+	}
+
+	this->write(to_byte_span(indices), offset * sizeof(index_type));
+}
+
+void index_buffer::update(utki::span<const uint16_t> indices, size_t offset)
+{
+	this->update_internal(indices, GL_UNSIGNED_SHORT, offset);
+}
+
+void index_buffer::update(utki::span<const uint32_t> indices, size_t offset)
+{
+	this->update_internal(indices, GL_UNSIGNED_INT, offset);
+}
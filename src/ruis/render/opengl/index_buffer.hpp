@@ -21,6 +21,8 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <vector>
+
 #include <ruis/render/index_buffer.hpp>
 #include <utki/span.hpp>
 
@@ -37,11 +39,41 @@ public:
 	const GLsizei elements_count;
 
 private:
-	index_buffer(const void* data, size_t size_bytes, size_t size, GLenum element_type);
+	std::vector<uint32_t> data;
+
+	index_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const uint8_t> data,
+		size_t size,
+		GLenum element_type,
+		std::vector<uint32_t> data_copy,
+		buffer_usage usage
+	);
+
+	template <typename index_type>
+	void update_internal(utki::span<const index_type> indices, GLenum element_type, size_t offset);
 
 public:
-	index_buffer(utki::span<const uint16_t> indices);
-	index_buffer(utki::span<const uint32_t> indices);
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param indices - index data.
+	 * @param keep_data - whether to keep CPU-side copy of the indices.
+	 * @param usage - buffer usage hint.
+	 */
+	index_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const uint16_t> indices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw
+	);
+
+	index_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const uint32_t> indices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw
+	);
 
 	index_buffer(const index_buffer&) = delete;
 	index_buffer& operator=(const index_buffer&) = delete;
@@ -51,7 +83,33 @@ public:
 
 	~index_buffer() override = default;
 
-private:
+	/**
+	 * @brief Get CPU-side copy of the indices.
+	 * The copy is kept only for index buffers which can be batched, see batcher.
+	 * @return CPU-side copy of the indices.
+	 * @return empty span if the copy is not kept.
+	 */
+	utki::span<const uint32_t> get_data() const noexcept
+	{
+		return this->data;
+	}
+
+	/**
+	 * @brief Update indices.
+	 * The index type must match the one of the index buffer.
+	 * The index buffer size cannot be changed.
+	 * If the whole buffer is updated and the buffer is not suballocated, its storage is orphaned
+	 * and re-specified, so that the update does not wait for pending draws which use the old contents.
+	 * Otherwise, the data is updated with glBufferSubData().
+	 * In deferred rendering mode the recorded commands are executed before updating.
+	 * @param indices - new indices.
+	 * @param offset - offset in indices from the beginning of the buffer.
+	 * @throw std::invalid_argument - if index type does not match.
+	 * @throw std::out_of_range - if the data does not fit into the buffer.
+	 */
+	void update(utki::span<const uint16_t> indices, size_t offset = 0);
+
+	void update(utki::span<const uint32_t> indices, size_t offset = 0);
 };
 
 } // namespace ruis::render::opengl
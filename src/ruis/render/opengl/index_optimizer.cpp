@@ -0,0 +1,226 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "index_optimizer.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+using namespace ruis::render::opengl;
+
+namespace {
+constexpr const size_t num_triangle_vertices = 3;
+
+// Tipsify state
+class tipsifier
+{
+	utki::span<const uint32_t> indices;
+	size_t cache_size;
+
+	// triangles adjacent to each vertex, in compressed form:
+	// triangles of vertex v are adjacency[adjacency_offsets[v]] to adjacency[adjacency_offsets[v + 1]]
+	std::vector<uint32_t> adjacency_offsets;
+	std::vector<uint32_t> adjacency;
+
+	// number of not yet emitted triangles of each vertex
+	std::vector<uint32_t> live_triangles;
+
+	// time when the vertex has entered the cache
+	std::vector<size_t> cache_time_stamps;
+
+	std::vector<bool> emitted;
+
+	std::vector<uint32_t> dead_end_stack;
+
+	size_t time_stamp;
+
+	// vertex to continue search for the next fanning vertex from, in case of dead end
+	uint32_t cursor = 0;
+
+	uint32_t num_vertices() const noexcept
+	{
+		return uint32_t(this->live_triangles.size());
+	}
+
+	// returns num_vertices() if there are no more triangles to emit
+	uint32_t skip_dead_end()
+	{
+		while (!this->dead_end_stack.empty()) {
+			auto v = this->dead_end_stack.back();
+			this->dead_end_stack.pop_back();
+			if (this->live_triangles[v] != 0) {
+				return v;
+			}
+		}
+
+		for (; this->cursor != this->num_vertices(); ++this->cursor) {
+			if (this->live_triangles[this->cursor] != 0) {
+				return this->cursor;
+			}
+		}
+
+		return this->num_vertices();
+	}
+
+	uint32_t get_next_vertex(const std::vector<uint32_t>& candidates)
+	{
+		auto best = this->num_vertices();
+		size_t best_priority = 0;
+
+		for (auto v : candidates) {
+			if (this->live_triangles[v] == 0) {
+				continue;
+			}
+
+			// prefer the oldest vertex in cache which will still be in cache after emitting
+			// all its remaining triangles
+			size_t priority = 0;
+			auto age = this->time_stamp - this->cache_time_stamps[v];
+			if (age + 2 * this->live_triangles[v] <= this->cache_size) {
+				priority = age;
+			}
+
+			if (best == this->num_vertices() || priority > best_priority) {
+				best = v;
+				best_priority = priority;
+			}
+		}
+
+		if (best == this->num_vertices()) {
+			return this->skip_dead_end();
+		}
+
+		return best;
+	}
+
+public:
+	tipsifier(utki::span<const uint32_t> indices, size_t cache_size) :
+		indices(indices),
+		cache_size(cache_size),
+		time_stamp(cache_size + 1)
+	{
+		uint32_t num_vertices = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end()) + 1;
+
+		this->live_triangles.resize(num_vertices, 0);
+		for (auto i : indices) {
+			++this->live_triangles[i];
+		}
+
+		this->adjacency_offsets.resize(size_t(num_vertices) + 1, 0);
+		for (uint32_t v = 0; v != num_vertices; ++v) {
+			this->adjacency_offsets[v + 1] = this->adjacency_offsets[v] + this->live_triangles[v];
+		}
+
+		this->adjacency.resize(indices.size());
+		auto fill_pos = this->adjacency_offsets;
+		for (size_t i = 0; i != indices.size(); ++i) {
+			auto v = indices[i];
+			this->adjacency[fill_pos[v]++] = uint32_t(i / num_triangle_vertices);
+		}
+
+		this->cache_time_stamps.resize(num_vertices, 0);
+		this->emitted.resize(indices.size() / num_triangle_vertices, false);
+	}
+
+	std::vector<uint32_t> run()
+	{
+		std::vector<uint32_t> ret;
+		ret.reserve(this->indices.size());
+
+		std::vector<uint32_t> candidates;
+
+		auto fanning_vertex = this->skip_dead_end();
+
+		while (fanning_vertex != this->num_vertices()) {
+			candidates.clear();
+
+			for (auto a = this->adjacency_offsets[fanning_vertex]; a != this->adjacency_offsets[fanning_vertex + 1];
+				 ++a)
+			{
+				auto t = this->adjacency[a];
+				if (this->emitted[t]) {
+					continue;
+				}
+
+				for (size_t i = 0; i != num_triangle_vertices; ++i) {
+					auto v = this->indices[t * num_triangle_vertices + i];
+
+					ret.push_back(v);
+					this->dead_end_stack.push_back(v);
+					candidates.push_back(v);
+					--this->live_triangles[v];
+
+					if (this->time_stamp - this->cache_time_stamps[v] > this->cache_size) {
+						this->cache_time_stamps[v] = this->time_stamp;
+						++this->time_stamp;
+					}
+				}
+
+				this->emitted[t] = true;
+			}
+
+			fanning_vertex = this->get_next_vertex(candidates);
+		}
+
+		ASSERT(ret.size() == this->indices.size())
+
+		return ret;
+	}
+};
+} // namespace
+
+std::vector<uint32_t> ruis::render::opengl::optimize_vertex_cache(utki::span<const uint32_t> indices, size_t cache_size)
+{
+	if (indices.size() % num_triangle_vertices != 0) {
+		throw std::invalid_argument("optimize_vertex_cache(): number of indices is not a multiple of 3");
+	}
+
+	return tipsifier(indices, cache_size).run();
+}
+
+float ruis::render::opengl::compute_acmr(utki::span<const uint32_t> indices, size_t cache_size)
+{
+	auto num_triangles = indices.size() / num_triangle_vertices;
+	if (num_triangles == 0) {
+		return 0;
+	}
+
+	std::deque<uint32_t> cache;
+	size_t num_misses = 0;
+
+	for (auto i : indices) {
+		if (std::find(cache.begin(), cache.end(), i) != cache.end()) {
+			continue;
+		}
+
+		++num_misses;
+
+		cache.push_back(i);
+		if (cache.size() > cache_size) {
+			cache.pop_front();
+		}
+	}
+
+	return float(num_misses) / float(num_triangles);
+}
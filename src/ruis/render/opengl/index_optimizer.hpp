@@ -0,0 +1,63 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <utki/span.hpp>
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Default size of the simulated post-transform vertex cache.
+ */
+constexpr const size_t default_vertex_cache_size = 16;
+
+/**
+ * @brief Reorder triangles for post-transform vertex cache locality.
+ * Uses the Tipsify algorithm by Sander, Nehab and Barczak, which runs in linear time.
+ * The triangles are fanned around vertices, so that the vertices stay in the cache
+ * while all triangles using them are drawn.
+ * @param indices - indices of the triangle list, i.e. GL_TRIANGLES.
+ * @param cache_size - size of the post-transform vertex cache to optimize for.
+ * @return reordered indices.
+ * @throw std::invalid_argument - if number of indices is not a multiple of 3.
+ */
+std::vector<uint32_t> optimize_vertex_cache(
+	utki::span<const uint32_t> indices,
+	size_t cache_size = default_vertex_cache_size
+);
+
+/**
+ * @brief Compute average cache miss ratio of the triangle list.
+ * The average cache miss ratio (ACMR) is the number of vertex shader invocations per triangle,
+ * simulated with FIFO post-transform vertex cache. The lower the better,
+ * with 0.5 being the theoretical minimum for big regular meshes, and 3 being the worst case.
+ * @param indices - indices of the triangle list, i.e. GL_TRIANGLES.
+ * @param cache_size - size of the simulated vertex cache.
+ * @return average cache miss ratio.
+ * @return 0 if there are no triangles.
+ */
+float compute_acmr(utki::span<const uint32_t> indices, size_t cache_size = default_vertex_cache_size);
+
+} // namespace ruis::render::opengl
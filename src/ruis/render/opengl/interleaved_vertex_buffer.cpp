@@ -0,0 +1,134 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "interleaved_vertex_buffer.hpp"
+
+#include <stdexcept>
+
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+size_t component_size(GLenum type)
+{
+	switch (type) {
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE:
+			return sizeof(GLubyte);
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT:
+			return sizeof(GLushort);
+		case GL_INT:
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT:
+			return sizeof(GLfloat);
+		default:
+			throw std::invalid_argument("interleaved_vertex_buffer: unsupported vertex attribute type");
+	}
+}
+
+const vertex_layout& check_layout(const vertex_layout& layout)
+{
+	if (layout.attributes.empty() || layout.stride == 0) {
+		throw std::invalid_argument("interleaved_vertex_buffer: empty vertex layout");
+	}
+
+	for (const auto& a : layout.attributes) {
+		if (a.num_components < 1 || a.num_components > 4) {
+			throw std::invalid_argument("interleaved_vertex_buffer: invalid number of attribute components");
+		}
+
+		auto size = size_t(a.num_components) * component_size(a.type);
+
+		if (a.offset > layout.stride || size > layout.stride - a.offset) {
+			throw std::invalid_argument("interleaved_vertex_buffer: vertex attribute does not fit into the stride");
+		}
+	}
+
+	return layout;
+}
+
+size_t to_num_vertices(utki::span<const uint8_t> data, const vertex_layout& layout)
+{
+	if (data.size() % layout.stride != 0) {
+		throw std::invalid_argument("interleaved_vertex_buffer: data size is not a multiple of the vertex stride");
+	}
+	return data.size() / layout.stride;
+}
+} // namespace
+
+interleaved_vertex_buffer::interleaved_vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const uint8_t> data,
+	vertex_layout layout,
+	buffer_usage usage
+) :
+	ruis::render::vertex_buffer(to_num_vertices(data, check_layout(layout))),
+	opengl_buffer(std::move(context), GL_ARRAY_BUFFER, data, usage),
+	layout(std::move(layout)),
+	num_vertices(this->size_bytes / this->layout.stride)
+{}
+
+void interleaved_vertex_buffer::bind_attributes(GLuint first_location) const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+	assert_opengl_no_error();
+
+	for (GLuint i = 0; i != this->layout.attributes.size(); ++i) {
+		const auto& a = this->layout.attributes[i];
+
+		glVertexAttribPointer(
+			first_location + i,
+			a.num_components,
+			a.type,
+			a.normalized ? GL_TRUE : GL_FALSE,
+			GLsizei(this->layout.stride),
+			// NOLINTNEXTLINE(performance-no-int-to-ptr)
+			reinterpret_cast<const GLvoid*>(this->offset + a.offset)
+		);
+		assert_opengl_no_error();
+
+		glEnableVertexAttribArray(first_location + i);
+		assert_opengl_no_error();
+	}
+}
+
+void interleaved_vertex_buffer::update(utki::span<const uint8_t> data, size_t offset)
+{
+	if (data.size() % this->layout.stride != 0) {
+		throw std::invalid_argument(
+			"interleaved_vertex_buffer::update(): data size is not a multiple of the vertex stride"
+		);
+	}
+
+	auto num = data.size() / this->layout.stride;
+
+	if (offset > this->num_vertices || num > this->num_vertices - offset) {
+		throw std::out_of_range("interleaved_vertex_buffer::update(): data does not fit into the buffer");
+	}
+
+	// recorded draws use the current contents of the buffer
+	this->context.get().flush();
+
+	this->write(data, offset * this->layout.stride);
+}
@@ -0,0 +1,132 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <vector>
+
+#include <ruis/render/vertex_buffer.hpp>
+#include <utki/span.hpp>
+
+#include "opengl_buffer.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Vertex attribute format within interleaved vertex.
+ */
+struct vertex_attribute {
+	/**
+	 * @brief Number of components, from 1 to 4.
+	 */
+	GLint num_components = 0;
+
+	/**
+	 * @brief Component type, e.g. GL_FLOAT.
+	 */
+	GLenum type = GL_FLOAT;
+
+	/**
+	 * @brief Whether integer components are normalized to [0, 1] or [-1, 1] range.
+	 * Ignored for floating point types.
+	 */
+	bool normalized = false;
+
+	/**
+	 * @brief Offset of the attribute from the beginning of the vertex in bytes.
+	 */
+	size_t offset = 0;
+};
+
+/**
+ * @brief Interleaved vertex layout.
+ */
+struct vertex_layout {
+	/**
+	 * @brief Vertex attributes.
+	 * The attributes are assigned to consecutive attribute locations.
+	 */
+	std::vector<vertex_attribute> attributes;
+
+	/**
+	 * @brief Size of the vertex in bytes.
+	 */
+	size_t stride = 0;
+};
+
+/**
+ * @brief Vertex buffer with several vertex attributes interleaved.
+ * All attributes of a vertex are stored next to each other, so drawing the vertex buffer
+ * needs a single buffer bind and fetches vertex data from adjacent memory.
+ * In a vertex array, the interleaved vertex buffer takes as many attribute locations
+ * as there are attributes in its layout.
+ */
+class interleaved_vertex_buffer :
+	public ruis::render::vertex_buffer, //
+	public opengl_buffer
+{
+public:
+	const vertex_layout layout;
+	const size_t num_vertices;
+
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param data - vertex data, number of vertices is the data size divided by the layout stride.
+	 * @param layout - vertex layout.
+	 * @param usage - buffer usage hint.
+	 * @throw std::invalid_argument - if the layout is invalid or data size is not a multiple of the layout stride.
+	 */
+	interleaved_vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const uint8_t> data,
+		vertex_layout layout,
+		buffer_usage usage = buffer_usage::static_draw
+	);
+
+	interleaved_vertex_buffer(const interleaved_vertex_buffer&) = delete;
+	interleaved_vertex_buffer& operator=(const interleaved_vertex_buffer&) = delete;
+
+	interleaved_vertex_buffer(interleaved_vertex_buffer&&) = delete;
+	interleaved_vertex_buffer& operator=(interleaved_vertex_buffer&&) = delete;
+
+	~interleaved_vertex_buffer() override = default;
+
+	/**
+	 * @brief Set vertex attribute pointers for all attributes of the layout.
+	 * Binds the buffer to GL_ARRAY_BUFFER and enables the vertex attribute arrays.
+	 * @param first_location - attribute location of the first attribute.
+	 */
+	void bind_attributes(GLuint first_location) const;
+
+	/**
+	 * @brief Update vertex data.
+	 * The vertex buffer size cannot be changed.
+	 * In deferred rendering mode the recorded commands are executed before updating.
+	 * @param data - new vertex data.
+	 * @param offset - offset in vertices from the beginning of the buffer.
+	 * @throw std::invalid_argument - if data size is not a multiple of the layout stride.
+	 * @throw std::out_of_range - if the data does not fit into the buffer.
+	 */
+	void update(utki::span<const uint8_t> data, size_t offset = 0);
+};
+
+} // namespace ruis::render::opengl
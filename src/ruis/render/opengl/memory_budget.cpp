@@ -0,0 +1,197 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "memory_budget.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <utki/debug.hpp>
+
+#include "context.hpp"
+#include "name_pool.hpp"
+#include "texture_2d.hpp"
+
+using namespace ruis::render::opengl;
+
+memory_budget::memory_budget(opengl::context& context) :
+	context(context)
+{}
+
+void memory_budget::allocate(category c, size_t size)
+{
+	ASSERT(this->context.is_context_thread())
+
+	this->make_room(size);
+
+	this->num_bytes[size_t(c)].fetch_add(size, std::memory_order_relaxed);
+
+	this->update_peak_usage();
+}
+
+void memory_budget::free(category c, size_t size) noexcept
+{
+	ASSERT(this->num_bytes[size_t(c)].load(std::memory_order_relaxed) >= size)
+	this->num_bytes[size_t(c)].fetch_sub(size, std::memory_order_relaxed);
+}
+
+memory_budget::usage memory_budget::get_usage() const
+{
+	return {
+		.textures = this->num_bytes[size_t(category::texture)].load(std::memory_order_relaxed),
+		.buffers = this->num_bytes[size_t(category::buffer)].load(std::memory_order_relaxed),
+		.internal_buffers = this->context.get_internal_buffers_size(),
+		.cached = this->context.get_name_pool().get_num_cached_bytes()
+	};
+}
+
+void memory_budget::update_peak_usage()
+{
+	this->stats.peak_usage = std::max(this->stats.peak_usage, this->get_usage().total());
+}
+
+bool memory_budget::make_room(size_t size)
+{
+	if (this->budget == 0) {
+		return true;
+	}
+
+	auto fits = [this, size]() {
+		return this->get_usage().total() + size <= this->budget;
+	};
+
+	if (fits()) {
+		return true;
+	}
+
+	// cached objects are cheaper to lose than the texel data of live textures
+	this->context.get_name_pool().trim();
+
+	if (fits()) {
+		return true;
+	}
+
+	std::lock_guard lock(this->mutex);
+
+	while (!this->resident.empty()) {
+		auto i = std::prev(this->resident.end());
+		auto& tex = **i;
+
+		if (tex.last_used_frame == this->frame) {
+			// the rest of the textures were used even more recently
+			break;
+		}
+
+		this->evicted.splice(this->evicted.end(), this->resident, i);
+		tex.evicted = true;
+
+		++this->stats.num_evictions;
+		this->stats.num_evicted_bytes += tex.evict();
+
+		if (fits()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void memory_budget::evict_unused()
+{
+	this->context.get_name_pool().trim();
+
+	std::lock_guard lock(this->mutex);
+
+	for (auto i = this->resident.begin(); i != this->resident.end();) {
+		auto& tex = **i;
+
+		if (tex.last_used_frame == this->frame) {
+			++i;
+			continue;
+		}
+
+		auto next = std::next(i);
+		this->evicted.splice(this->evicted.end(), this->resident, i);
+		i = next;
+
+		tex.evicted = true;
+
+		++this->stats.num_evictions;
+		this->stats.num_evicted_bytes += tex.evict();
+	}
+}
+
+void memory_budget::add(texture_2d& tex)
+{
+	ASSERT(this->context.is_context_thread())
+
+	std::lock_guard lock(this->mutex);
+
+	tex.last_used_frame = this->frame;
+	tex.evicted = false;
+	this->resident.push_front(&tex);
+	tex.lru_position = this->resident.begin();
+}
+
+void memory_budget::remove(texture_2d& tex)
+{
+	std::lock_guard lock(this->mutex);
+
+	if (tex.evicted) {
+		this->evicted.erase(tex.lru_position);
+	} else {
+		this->resident.erase(tex.lru_position);
+	}
+}
+
+void memory_budget::touch(const texture_2d& tex)
+{
+	ASSERT(this->context.is_context_thread())
+
+	std::unique_lock lock(this->mutex);
+
+	// get non-const texture from the list
+	auto& t = **tex.lru_position;
+	ASSERT(&t == &tex)
+
+	t.last_used_frame = this->frame;
+
+	if (!t.evicted) {
+		this->resident.splice(this->resident.begin(), this->resident, t.lru_position);
+		return;
+	}
+
+	this->resident.splice(this->resident.begin(), this->evicted, t.lru_position);
+	t.evicted = false;
+
+	// restoring allocates the texture storage, which can evict other textures
+	lock.unlock();
+
+	t.restore();
+
+	++this->stats.num_restorations;
+}
+
+void memory_budget::end_frame()
+{
+	this->make_room(0);
+	++this->frame;
+}
@@ -0,0 +1,243 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+namespace ruis::render::opengl {
+
+class context;
+class texture_2d;
+
+/**
+ * @brief GPU memory accounting and budget.
+ * Tracks the size of the storage of the live textures and buffers. Also reports the size of the context's
+ * internal buffers and of the objects cached in the name pool, see name_pool.
+ *
+ * In case a budget is set, the memory usage is kept within it by evicting the storage of the
+ * evictable textures, see factory::create_evictable_texture_2d(). The evictable textures are kept
+ * in least recently used order. Textures which were used during the current frame are never evicted,
+ * because the pending draws can refer to them. An evicted texture has its storage re-created and
+ * its texel data re-uploaded from the kept image the next time it is bound.
+ * The budget is a soft limit, it is exceeded if there is nothing left to evict.
+ *
+ * The frames are counted by end_frame(), which is called when the context's frame is finished,
+ * see context::end_frame(). Until the first frame is finished, all textures count as used during
+ * the current frame, so none of them are evicted.
+ */
+class memory_budget
+{
+public:
+	enum class category {
+		texture,
+		buffer,
+
+		enum_size
+	};
+
+	struct usage {
+		/**
+		 * @brief Total size of the live textures storage in bytes, including mipmaps.
+		 */
+		size_t textures = 0;
+
+		/**
+		 * @brief Total size of the live buffers storage in bytes.
+		 */
+		size_t buffers = 0;
+
+		/**
+		 * @brief Total size of the context's internal buffers in bytes.
+		 * Those are stream buffers, transform buffer and buffer arena pages.
+		 */
+		size_t internal_buffers = 0;
+
+		/**
+		 * @brief Total size of the objects cached in the name pool in bytes.
+		 */
+		size_t cached = 0;
+
+		size_t total() const noexcept
+		{
+			return this->textures + this->buffers + this->internal_buffers + this->cached;
+		}
+	};
+
+	struct statistics {
+		/**
+		 * @brief Maximum total memory usage in bytes.
+		 */
+		size_t peak_usage = 0;
+
+		/**
+		 * @brief Number of texture evictions.
+		 */
+		size_t num_evictions = 0;
+
+		/**
+		 * @brief Total size of the evicted texture storage in bytes.
+		 */
+		size_t num_evicted_bytes = 0;
+
+		/**
+		 * @brief Number of evicted textures restored on bind.
+		 */
+		size_t num_restorations = 0;
+	};
+
+private:
+	opengl::context& context;
+
+	// live objects can be destroyed on other threads, see deletion_queue
+	std::array<std::atomic<size_t>, size_t(category::enum_size)> num_bytes = {};
+
+	size_t budget = 0;
+
+	uint64_t frame = 0;
+
+	// guards the texture lists, evictable textures can be destroyed on other threads
+	std::mutex mutex;
+
+	// evictable textures which have storage, most recently used first
+	std::list<texture_2d*> resident;
+
+	// evictable textures without storage
+	std::list<texture_2d*> evicted;
+
+	statistics stats;
+
+	// evicts least recently used textures until the given size fits into the budget,
+	// returns true if it fits
+	bool make_room(size_t size);
+
+	void update_peak_usage();
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context to report the internal buffers and cached objects of.
+	 */
+	memory_budget(opengl::context& context);
+
+	memory_budget(const memory_budget&) = delete;
+	memory_budget& operator=(const memory_budget&) = delete;
+
+	memory_budget(memory_budget&&) = delete;
+	memory_budget& operator=(memory_budget&&) = delete;
+
+	~memory_budget() = default;
+
+	/**
+	 * @brief Account allocation of object storage.
+	 * Should be called right before the storage is allocated. In case the allocation would exceed the budget,
+	 * the name pool cache is trimmed and the least recently used textures are evicted to make room for it.
+	 * Must only be called on the context's thread.
+	 * @param c - category of the object.
+	 * @param size - size of the storage in bytes.
+	 */
+	void allocate(category c, size_t size);
+
+	/**
+	 * @brief Account release of object storage.
+	 * Can be called from any thread.
+	 * @param c - category of the object.
+	 * @param size - size of the storage in bytes.
+	 */
+	void free(category c, size_t size) noexcept;
+
+	/**
+	 * @brief Get memory usage.
+	 * Must only be called on the context's thread.
+	 * @return current memory usage.
+	 */
+	usage get_usage() const;
+
+	/**
+	 * @brief Set memory budget.
+	 * The budget is enforced at allocations and at the end of frame, see end_frame().
+	 * @param bytes - budget in bytes, 0 means unlimited.
+	 */
+	void set_budget(size_t bytes) noexcept
+	{
+		this->budget = bytes;
+	}
+
+	size_t get_budget() const noexcept
+	{
+		return this->budget;
+	}
+
+	/**
+	 * @brief Evict all textures which were not used during the current frame.
+	 * Also trims the name pool cache. Can be called, e.g. when the application goes to background,
+	 * or when an allocation fails due to lack of memory.
+	 * The pending batch must be flushed, see context::flush_batch().
+	 */
+	void evict_unused();
+
+	/**
+	 * @brief Register evictable texture.
+	 * Must only be called on the context's thread.
+	 * @param tex - texture which has its storage allocated.
+	 */
+	void add(texture_2d& tex);
+
+	/**
+	 * @brief Unregister evictable texture.
+	 * Can be called from any thread.
+	 * @param tex - texture to unregister.
+	 */
+	void remove(texture_2d& tex);
+
+	/**
+	 * @brief Mark evictable texture as used during the current frame.
+	 * Restores the texture if it was evicted.
+	 * Must only be called on the context's thread.
+	 * @param tex - texture to mark.
+	 */
+	void touch(const texture_2d& tex);
+
+	/**
+	 * @brief Mark the end of frame.
+	 * Evicts least recently used textures in case the memory usage exceeds the budget.
+	 * Called by the context when the frame is finished, after the pending draws are flushed,
+	 * see context::end_frame().
+	 */
+	void end_frame();
+
+	const statistics& get_statistics() const noexcept
+	{
+		return this->stats;
+	}
+
+	void reset_statistics() noexcept
+	{
+		this->stats = statistics();
+	}
+};
+
+} // namespace ruis::render::opengl
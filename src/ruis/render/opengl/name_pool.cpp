@@ -0,0 +1,252 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "name_pool.hpp"
+
+#include <algorithm>
+
+#include <utki/debug.hpp>
+
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+name_pool::name_pool(bool direct_state_access) :
+	direct_state_access(direct_state_access)
+{}
+
+name_pool::~name_pool()
+{
+	this->trim();
+
+	if (!this->unused_buffer_names.empty()) {
+		glDeleteBuffers(GLsizei(this->unused_buffer_names.size()), this->unused_buffer_names.data());
+	}
+	if (!this->unused_texture_names.empty()) {
+		glDeleteTextures(GLsizei(this->unused_texture_names.size()), this->unused_texture_names.data());
+	}
+}
+
+GLuint name_pool::gen_buffer()
+{
+	if (this->unused_buffer_names.empty()) {
+		this->unused_buffer_names.resize(gen_batch_size);
+		if (this->direct_state_access) {
+			glCreateBuffers(GLsizei(this->unused_buffer_names.size()), this->unused_buffer_names.data());
+		} else {
+			glGenBuffers(GLsizei(this->unused_buffer_names.size()), this->unused_buffer_names.data());
+		}
+		assert_opengl_no_error();
+	}
+
+	auto ret = this->unused_buffer_names.back();
+	this->unused_buffer_names.pop_back();
+	return ret;
+}
+
+GLuint name_pool::gen_texture(GLenum target)
+{
+	if (this->direct_state_access && target != GL_TEXTURE_2D) {
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		glCreateTextures(target, 1, &ret);
+		assert_opengl_no_error();
+		return ret;
+	}
+
+	if (this->unused_texture_names.empty()) {
+		this->unused_texture_names.resize(gen_batch_size);
+		if (this->direct_state_access) {
+			glCreateTextures(
+				GL_TEXTURE_2D, //
+				GLsizei(this->unused_texture_names.size()),
+				this->unused_texture_names.data()
+			);
+		} else {
+			glGenTextures(GLsizei(this->unused_texture_names.size()), this->unused_texture_names.data());
+		}
+		assert_opengl_no_error();
+	}
+
+	auto ret = this->unused_texture_names.back();
+	this->unused_texture_names.pop_back();
+	return ret;
+}
+
+GLuint name_pool::acquire_buffer(const buffer_storage& storage)
+{
+	auto i = this->cached_buffers.find(storage);
+	if (i == this->cached_buffers.end()) {
+		return 0;
+	}
+
+	auto ret = i->second.name;
+	this->cached_buffers.erase(i);
+
+	ASSERT(this->num_cached_bytes >= storage.size)
+	this->num_cached_bytes -= storage.size;
+
+	++this->stats.num_reused_buffers;
+
+	return ret;
+}
+
+void name_pool::recycle_buffer(GLuint buffer, const buffer_storage& storage)
+{
+	if (this->num_cached_bytes + storage.size > this->memory_cap) {
+		glDeleteBuffers(1, &buffer);
+		assert_opengl_no_error();
+		++this->stats.num_evicted;
+		return;
+	}
+
+	// orphan the storage, so that the new owner does not wait for pending draws
+	if (this->direct_state_access) {
+		glNamedBufferData(buffer, GLsizeiptr(storage.size), nullptr, storage.usage);
+	} else {
+		// Binding element array buffer changes the currently bound vertex array object state,
+		// vertex arrays are unbound after drawing, so no vertex array object is bound here.
+		glBindBuffer(storage.target, buffer);
+		assert_opengl_no_error();
+
+		glBufferData(storage.target, GLsizeiptr(storage.size), nullptr, storage.usage);
+	}
+	assert_opengl_no_error();
+
+	this->cached_buffers.insert(std::make_pair(storage, cached_object{.name = buffer, .frame = this->frame_num}));
+	this->num_cached_bytes += storage.size;
+}
+
+GLuint name_pool::acquire_texture(const texture_storage& storage)
+{
+	auto range = this->cached_textures.equal_range(storage);
+	for (auto i = range.first; i != range.second; ++i) {
+		if (this->frame_num - i->second.frame < texture_reuse_delay_frames) {
+			// the GPU is possibly still using the texture
+			continue;
+		}
+
+		auto ret = i->second.name;
+		this->cached_textures.erase(i);
+
+		ASSERT(this->num_cached_bytes >= storage.size)
+		this->num_cached_bytes -= storage.size;
+
+		++this->stats.num_reused_textures;
+
+		return ret;
+	}
+
+	return 0;
+}
+
+void name_pool::recycle_texture(GLuint texture, const texture_storage& storage)
+{
+	if (this->num_cached_bytes + storage.size > this->memory_cap) {
+		glDeleteTextures(1, &texture);
+		assert_opengl_no_error();
+		++this->stats.num_evicted;
+		return;
+	}
+
+	this->cached_textures.insert(std::make_pair(storage, cached_object{.name = texture, .frame = this->frame_num}));
+	this->num_cached_bytes += storage.size;
+}
+
+template <typename predicate_type>
+void name_pool::delete_cached(const predicate_type& pred)
+{
+	std::vector<GLuint> names;
+
+	auto collect = [&](auto& cache) {
+		for (auto i = cache.begin(); i != cache.end();) {
+			if (!pred(i->second)) {
+				++i;
+				continue;
+			}
+			names.push_back(i->second.name);
+			ASSERT(this->num_cached_bytes >= i->first.size)
+			this->num_cached_bytes -= i->first.size;
+			i = cache.erase(i);
+		}
+	};
+
+	collect(this->cached_buffers);
+	if (!names.empty()) {
+		glDeleteBuffers(GLsizei(names.size()), names.data());
+		assert_opengl_no_error();
+		this->stats.num_evicted += names.size();
+		names.clear();
+	}
+
+	collect(this->cached_textures);
+	if (!names.empty()) {
+		glDeleteTextures(GLsizei(names.size()), names.data());
+		assert_opengl_no_error();
+		this->stats.num_evicted += names.size();
+	}
+}
+
+void name_pool::set_memory_cap(size_t cap)
+{
+	this->memory_cap = cap;
+
+	if (this->num_cached_bytes <= this->memory_cap) {
+		return;
+	}
+
+	// delete the oldest objects until the cached objects fit into the new cap
+	while (this->num_cached_bytes > this->memory_cap) {
+		uint64_t oldest = this->frame_num;
+		for (const auto& c : this->cached_buffers) {
+			oldest = std::min(oldest, c.second.frame);
+		}
+		for (const auto& c : this->cached_textures) {
+			oldest = std::min(oldest, c.second.frame);
+		}
+
+		this->delete_cached([oldest](const cached_object& c) {
+			return c.frame == oldest;
+		});
+	}
+}
+
+void name_pool::end_frame()
+{
+	++this->frame_num;
+
+	if (this->frame_num < max_idle_frames) {
+		return;
+	}
+
+	auto idle_threshold = this->frame_num - max_idle_frames;
+
+	this->delete_cached([idle_threshold](const cached_object& c) {
+		return c.frame < idle_threshold;
+	});
+}
+
+void name_pool::trim()
+{
+	this->delete_cached([](const cached_object&) {
+		return true;
+	});
+}
@@ -0,0 +1,263 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Pool of OpenGL buffer and texture names.
+ * Names are generated in batches instead of one at a time.
+ *
+ * Buffers and textures which are not needed anymore can be recycled to the pool
+ * instead of being deleted. Then, a new buffer or texture of the same size and format
+ * reuses the recycled object along with its storage, avoiding the object creation
+ * and storage allocation. The storage of a recycled buffer is orphaned, so the new owner
+ * can write the buffer without waiting for pending draws which use the old contents.
+ * A recycled texture is reused only after a few frames, when the GPU has finished using
+ * its old contents.
+ *
+ * The total size of the cached objects is limited by the memory cap. The objects which
+ * are not reused for a while are deleted, see end_frame().
+ *
+ * The frames are counted by end_frame(), which is called when the context's frame is finished,
+ * see context::end_frame(). Without finished frames, recycled textures are never reused
+ * and the cached objects are only deleted when the memory cap is exceeded.
+ */
+class name_pool
+{
+public:
+	/**
+	 * @brief Number of names generated at once.
+	 */
+	constexpr static const size_t gen_batch_size = 64;
+
+	/**
+	 * @brief Default limit of the total size of the cached objects in bytes.
+	 */
+	constexpr static const size_t default_memory_cap = size_t(16) * 1024 * 1024;
+
+	/**
+	 * @brief Number of frames a cached object is kept for before it is deleted.
+	 */
+	constexpr static const unsigned max_idle_frames = 120;
+
+	/**
+	 * @brief Number of frames a recycled texture is not reused for.
+	 * Should be not less than the number of frames the GPU lags behind the CPU.
+	 */
+	constexpr static const unsigned texture_reuse_delay_frames = 2;
+
+	struct buffer_storage {
+		GLenum target;
+		size_t size;
+		GLenum usage;
+
+		bool operator<(const buffer_storage& s) const noexcept
+		{
+			return std::tie(this->target, this->size, this->usage) < std::tie(s.target, s.size, s.usage);
+		}
+	};
+
+	struct texture_storage {
+		GLint internal_format;
+		GLsizei width;
+		GLsizei height;
+		GLsizei num_levels;
+
+		/**
+		 * @brief Estimated size of the texture storage in bytes.
+		 */
+		size_t size;
+
+		bool operator<(const texture_storage& s) const noexcept
+		{
+			return std::tie(this->internal_format, this->width, this->height, this->num_levels, this->size) <
+				std::tie(s.internal_format, s.width, s.height, s.num_levels, s.size);
+		}
+	};
+
+	struct statistics {
+		/**
+		 * @brief Number of buffers reused from the pool.
+		 */
+		size_t num_reused_buffers = 0;
+
+		/**
+		 * @brief Number of textures reused from the pool.
+		 */
+		size_t num_reused_textures = 0;
+
+		/**
+		 * @brief Number of objects deleted because the pool had no room for them or they were idle.
+		 */
+		size_t num_evicted = 0;
+	};
+
+private:
+	const bool direct_state_access;
+
+	std::vector<GLuint> unused_buffer_names;
+
+	// GL_TEXTURE_2D texture names
+	std::vector<GLuint> unused_texture_names;
+
+	struct cached_object {
+		GLuint name;
+
+		// frame when the object was recycled
+		uint64_t frame;
+	};
+
+	std::multimap<buffer_storage, cached_object> cached_buffers;
+	std::multimap<texture_storage, cached_object> cached_textures;
+
+	size_t num_cached_bytes = 0;
+	size_t memory_cap = default_memory_cap;
+
+	uint64_t frame_num = 0;
+
+	statistics stats;
+
+	// deletes cached objects for which the predicate returns true
+	template <typename predicate_type>
+	void delete_cached(const predicate_type& pred);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param direct_state_access - whether to create the objects using direct state access functions.
+	 *        In this case the names are generated with glCreate*() functions, so the names refer
+	 *        to existing objects right away, as required by direct state access functions.
+	 */
+	name_pool(bool direct_state_access);
+
+	name_pool(const name_pool&) = delete;
+	name_pool& operator=(const name_pool&) = delete;
+
+	name_pool(name_pool&&) = delete;
+	name_pool& operator=(name_pool&&) = delete;
+
+	~name_pool();
+
+	/**
+	 * @brief Get unused buffer name.
+	 * @return buffer name without storage.
+	 */
+	GLuint gen_buffer();
+
+	/**
+	 * @brief Get unused texture name.
+	 * Only GL_TEXTURE_2D texture names are generated in batches.
+	 * @param target - texture target, texture created with direct state access functions
+	 *        can only be bound to this target.
+	 * @return texture name without storage.
+	 */
+	GLuint gen_texture(GLenum target = GL_TEXTURE_2D);
+
+	/**
+	 * @brief Get recycled buffer.
+	 * @param storage - required buffer storage.
+	 * @return name of a recycled buffer which has the required storage.
+	 * @return 0 if there is no such buffer in the pool.
+	 */
+	GLuint acquire_buffer(const buffer_storage& storage);
+
+	/**
+	 * @brief Recycle buffer.
+	 * Orphans the buffer storage and caches the buffer, or deletes the buffer
+	 * if the memory cap would be exceeded.
+	 * In case the buffer is cached without direct state access, it is left bound to its target.
+	 * @param buffer - buffer name.
+	 * @param storage - buffer storage.
+	 */
+	void recycle_buffer(GLuint buffer, const buffer_storage& storage);
+
+	/**
+	 * @brief Get recycled texture.
+	 * @param storage - required texture storage.
+	 * @return name of a recycled texture which has the required storage.
+	 * @return 0 if there is no such texture in the pool.
+	 */
+	GLuint acquire_texture(const texture_storage& storage);
+
+	/**
+	 * @brief Recycle texture.
+	 * Caches the texture, or deletes the texture if the memory cap would be exceeded.
+	 * @param texture - texture name.
+	 * @param storage - texture storage.
+	 */
+	void recycle_texture(GLuint texture, const texture_storage& storage);
+
+	/**
+	 * @brief Set limit of the total size of the cached objects.
+	 * Cached objects over the limit are deleted right away.
+	 * @param cap - limit in bytes, 0 disables caching.
+	 */
+	void set_memory_cap(size_t cap);
+
+	size_t get_memory_cap() const noexcept
+	{
+		return this->memory_cap;
+	}
+
+	/**
+	 * @brief Get total size of the cached objects.
+	 * @return estimated size of the cached objects storage in bytes.
+	 */
+	size_t get_num_cached_bytes() const noexcept
+	{
+		return this->num_cached_bytes;
+	}
+
+	/**
+	 * @brief Mark the end of frame.
+	 * Deletes cached objects which were not reused for max_idle_frames frames.
+	 * Called by the context when the frame is finished, see context::end_frame().
+	 */
+	void end_frame();
+
+	/**
+	 * @brief Delete all cached objects.
+	 * Can be called when the application is idle to release memory.
+	 */
+	void trim();
+
+	const statistics& get_statistics() const noexcept
+	{
+		return this->stats;
+	}
+
+	void reset_statistics() noexcept
+	{
+		this->stats = statistics();
+	}
+};
+
+} // namespace ruis::render::opengl
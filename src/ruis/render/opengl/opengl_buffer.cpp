@@ -21,24 +21,157 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "opengl_buffer.hpp"
 
+#include <utki/debug.hpp>
+
+#include "deletion_queue.hpp"
+#include "memory_budget.hpp"
 #include "util.hpp"
 
 using namespace ruis::render::opengl;
 
-opengl_buffer::opengl_buffer() :
-	buffer([]() -> GLuint {
-		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
-		GLuint ret;
-		glGenBuffers(1, &ret);
-		assert_opengl_no_error();
-		return ret;
-	}())
-{}
+GLenum ruis::render::opengl::to_gl_usage(buffer_usage usage)
+{
+	switch (usage) {
+		default:
+			ASSERT(false)
+			[[fallthrough]];
+		case buffer_usage::static_draw:
+			return GL_STATIC_DRAW;
+		case buffer_usage::dynamic_draw:
+			return GL_DYNAMIC_DRAW;
+		case buffer_usage::stream_draw:
+			return GL_STREAM_DRAW;
+	}
+}
 
-opengl_buffer::~opengl_buffer()
+opengl_buffer::opengl_buffer(
+	utki::shared_ref<opengl::context> context,
+	GLenum target,
+	utki::span<const uint8_t> data,
+	buffer_usage usage
+) :
+	context(std::move(context)),
+	target(target),
+	usage(usage),
+	allocation([&]() {
+		if (usage != buffer_usage::static_draw || data.empty() || data.size() > buffer_arena::max_allocation_size) {
+			return buffer_arena::allocation();
+		}
+		return this->context.get().get_buffer_arena(target).allocate(data.size());
+	}()),
+	recycled_buffer([&]() -> GLuint {
+		if (!this->allocation.empty()) {
+			return 0;
+		}
+		return this->context.get().get_name_pool().acquire_buffer(
+			{.target = target, .size = data.size(), .usage = to_gl_usage(usage)}
+		);
+	}()),
+	buffer([this]() -> GLuint {
+		if (!this->allocation.empty()) {
+			return this->allocation.buffer;
+		}
+		if (this->recycled_buffer != 0) {
+			return this->recycled_buffer;
+		}
+		return this->context.get().get_name_pool().gen_buffer();
+	}()),
+	offset(this->allocation.offset),
+	size_bytes(data.size())
+{
+	if (!this->is_suballocated()) {
+		// suballocated slices are accounted as the context's internal buffers
+		this->context.get().get_memory_budget().allocate(memory_budget::category::buffer, this->size_bytes);
+	}
+
+	if (this->is_suballocated() || this->recycled_buffer != 0) {
+		// the storage is already allocated
+		if (!data.empty()) {
+			this->set_sub_data(data, this->offset);
+		}
+	} else {
+		this->set_data(data);
+	}
+}
+
+void opengl_buffer::bind_for_editing() const
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	ASSERT(!this->context.get().is_direct_state_access_enabled())
+
+	// Binding element array buffer changes the currently bound vertex array object state,
+	// vertex arrays are unbound after drawing, so no vertex array object is bound here.
+	glBindBuffer(this->target, this->buffer);
 	assert_opengl_no_error();
-	glDeleteBuffers(1, &this->buffer);
+}
+
+void opengl_buffer::set_data(utki::span<const uint8_t> data)
+{
+	ASSERT(!this->is_suballocated())
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		glNamedBufferData(this->buffer, GLsizeiptr(data.size_bytes()), data.data(), to_gl_usage(this->usage));
+	} else {
+		this->bind_for_editing();
+		glBufferData(this->target, GLsizeiptr(data.size_bytes()), data.data(), to_gl_usage(this->usage));
+	}
 	assert_opengl_no_error();
 }
+
+void opengl_buffer::set_sub_data(utki::span<const uint8_t> data, size_t buffer_offset)
+{
+	if (this->context.get().is_direct_state_access_enabled()) {
+		glNamedBufferSubData(this->buffer, GLintptr(buffer_offset), GLsizeiptr(data.size_bytes()), data.data());
+	} else {
+		this->bind_for_editing();
+		glBufferSubData(this->target, GLintptr(buffer_offset), GLsizeiptr(data.size_bytes()), data.data());
+	}
+	assert_opengl_no_error();
+}
+
+opengl_buffer::~opengl_buffer()
+{
+	if (!this->is_suballocated()) {
+		this->context.get().get_memory_budget().free(memory_budget::category::buffer, this->size_bytes);
+	}
+
+	if (!this->context.get().is_context_thread()) {
+		if (this->is_suballocated()) {
+			this->context.get().get_deletion_queue().push({
+				.type = deletion_queue::object_type::arena_slice,
+				.slice = this->allocation,
+				.target = this->target //
+			});
+		} else {
+			this->context.get().get_deletion_queue().push({
+				.type = deletion_queue::object_type::buffer,
+				.name = this->buffer //
+			});
+		}
+		return;
+	}
+
+	if (this->is_suballocated()) {
+		this->context.get().get_buffer_arena(this->target).free(this->allocation);
+		return;
+	}
+
+	this->context.get().get_name_pool().recycle_buffer(this->buffer, this->get_storage());
+}
+
+name_pool::buffer_storage opengl_buffer::get_storage() const
+{
+	return {.target = this->target, .size = this->size_bytes, .usage = to_gl_usage(this->usage)};
+}
+
+void opengl_buffer::write(utki::span<const uint8_t> data, size_t offset)
+{
+	ASSERT(offset <= this->size_bytes)
+	ASSERT(data.size() <= this->size_bytes - offset)
+
+	if (!this->is_suballocated() && data.size() == this->size_bytes) {
+		// orphan the old storage
+		this->set_data(data);
+	} else {
+		this->set_sub_data(data, this->offset + offset);
+	}
+}
@@ -22,15 +22,105 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <GL/glew.h>
+#include <utki/shared_ref.hpp>
+#include <utki/span.hpp>
+
+#include "buffer_arena.hpp"
+#include "context.hpp"
+#include "name_pool.hpp"
 
 namespace ruis::render::opengl {
 
+/**
+ * @brief Buffer data usage hint.
+ */
+enum class buffer_usage {
+	/**
+	 * @brief Data is specified once and drawn many times.
+	 */
+	static_draw,
+
+	/**
+	 * @brief Data is updated repeatedly and drawn many times, e.g. animated geometry.
+	 */
+	dynamic_draw,
+
+	/**
+	 * @brief Data is updated before every draw.
+	 */
+	stream_draw
+};
+
+GLenum to_gl_usage(buffer_usage usage);
+
+/**
+ * @brief OpenGL buffer data.
+ * Small static buffers are slices of the context's buffer arena pages, see buffer_arena.
+ * Other buffers have their own OpenGL buffer which is taken from and returned to
+ * the context's name pool, see name_pool. The buffer data starts at the offset
+ * within the OpenGL buffer, so the offset has to be taken into account when the buffer
+ * is used in vertex attribute pointers and draw calls.
+ * The buffer data is written using direct state access if it is enabled in the context,
+ * so that the current buffer bindings are not changed.
+ */
 class opengl_buffer
 {
 public:
+	const utki::shared_ref<opengl::context> context;
+
+	const GLenum target;
+
+	const buffer_usage usage;
+
+private:
+	const buffer_arena::allocation allocation;
+
+	// name of the buffer taken from the name pool along with its storage, 0 if none
+	const GLuint recycled_buffer;
+
+	name_pool::buffer_storage get_storage() const;
+
+	// binds the buffer to its target, only used when direct state access is not available
+	void bind_for_editing() const;
+
+	// (re)allocates the whole OpenGL buffer storage, only for non-suballocated buffers
+	void set_data(utki::span<const uint8_t> data);
+
+	// writes the data at the offset from the beginning of the OpenGL buffer
+	void set_sub_data(utki::span<const uint8_t> data, size_t buffer_offset);
+
+public:
+	/**
+	 * @brief OpenGL buffer name.
+	 */
 	const GLuint buffer;
 
-	opengl_buffer();
+	/**
+	 * @brief Offset of the data within the OpenGL buffer in bytes.
+	 */
+	const size_t offset;
+
+	/**
+	 * @brief Size of the data in bytes.
+	 */
+	const size_t size_bytes;
+
+	/**
+	 * @brief Constructor.
+	 * Buffers with static_draw usage and not bigger than buffer_arena::max_allocation_size
+	 * are allocated from the context's buffer arena. For other buffers, a recycled buffer
+	 * of the same size and usage is reused if there is one in the context's name pool.
+	 * @param context - OpenGL context.
+	 * @param target - buffer binding target, either GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER.
+	 * @param data - initial buffer data.
+	 * @param usage - buffer usage hint.
+	 */
+	opengl_buffer(
+		utki::shared_ref<opengl::context> context,
+		GLenum target,
+		utki::span<const uint8_t> data,
+		buffer_usage usage
+	);
 
 	opengl_buffer(const opengl_buffer&) = delete;
 	opengl_buffer& operator=(const opengl_buffer&) = delete;
@@ -40,7 +130,37 @@ public:
 
 	virtual ~opengl_buffer();
 
-private:
+	/**
+	 * @brief Check if the buffer is a slice of the buffer arena page.
+	 * @return true if the buffer shares the OpenGL buffer with other buffers.
+	 */
+	bool is_suballocated() const noexcept
+	{
+		return !this->allocation.empty();
+	}
+
+	/**
+	 * @brief Get the data offset as pointer.
+	 * Vertex attribute pointer and draw call functions take the buffer offset as pointer.
+	 * @return offset of the data within the OpenGL buffer.
+	 */
+	const GLvoid* get_offset_pointer() const noexcept
+	{
+		// NOLINTNEXTLINE(performance-no-int-to-ptr)
+		return reinterpret_cast<const GLvoid*>(this->offset);
+	}
+
+protected:
+	/**
+	 * @brief Write data to the buffer.
+	 * If the whole buffer has its own OpenGL buffer and the whole buffer is written,
+	 * its storage is orphaned and re-specified, so that the write does not wait
+	 * for pending draws which use the old contents.
+	 * Otherwise, the data is written with glBufferSubData().
+	 * @param data - data to write.
+	 * @param offset - offset in bytes from the beginning of the buffer data.
+	 */
+	void write(utki::span<const uint8_t> data, size_t offset);
 };
 
 } // namespace ruis::render::opengl
@@ -21,62 +21,99 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "opengl_texture.hpp"
 
+#include <stdexcept>
+
+#include "deletion_queue.hpp"
+#include "memory_budget.hpp"
 #include "util.hpp"
 
 using namespace ruis::render::opengl;
 
-opengl_texture::opengl_texture()
+opengl_texture::opengl_texture(utki::shared_ref<opengl::context> context, GLenum target) :
+	context(std::move(context))
 {
-	glGenTextures(1, &this->tex);
-	assert_opengl_no_error();
+	this->tex = this->context.get().get_name_pool().gen_texture(target);
 	ASSERT(this->tex != 0)
 }
 
+opengl_texture::opengl_texture(
+	utki::shared_ref<opengl::context> context, //
+	const name_pool::texture_storage& storage
+) :
+	context(std::move(context)),
+	storage(storage)
+{
+	auto& names = this->context.get().get_name_pool();
+
+	this->tex = names.acquire_texture(storage);
+	if (this->tex != 0) {
+		this->recycled = true;
+	} else {
+		this->tex = names.gen_texture();
+	}
+	ASSERT(this->tex != 0)
+
+	this->set_memory_size(storage.size);
+}
+
 opengl_texture::~opengl_texture()
 {
+	this->context.get().get_memory_budget().free(memory_budget::category::texture, this->memory_size);
+
+	if (this->tex == 0) {
+		// storage was evicted, see memory_budget
+		return;
+	}
+
+	if (!this->context.get().is_context_thread()) {
+		this->context.get().get_deletion_queue().push({
+			.type = deletion_queue::object_type::texture,
+			.name = this->tex //
+		});
+		return;
+	}
+
+	this->context.get().forget_texture(this->tex);
+
+	if (this->storage.has_value()) {
+		this->context.get().get_name_pool().recycle_texture(this->tex, this->storage.value());
+		return;
+	}
+
 	glDeleteTextures(1, &this->tex);
 }
 
-void opengl_texture::set_active_texture(unsigned unit_num) const
+void opengl_texture::bind(unsigned unit_num) const
 {
-	// OpenGL guarantees that GL_TEXTUREi = GL_TEXTURE0 + i
-	glActiveTexture(GL_TEXTURE0 + unit_num);
-	assert_opengl_no_error();
+	this->context.get().bind_texture(unit_num, GL_TEXTURE_2D, this->tex);
 }
 
-void opengl_texture::bind(unsigned unit_num) const
+size_t opengl_texture::set_memory_size(size_t size)
 {
-	this->set_active_texture(unit_num);
+	auto& budget = this->context.get().get_memory_budget();
 
-	glBindTexture(GL_TEXTURE_2D, this->tex);
-	assert_opengl_no_error();
+	auto old_size = this->memory_size;
+	budget.free(memory_budget::category::texture, old_size);
+	this->memory_size = 0;
+
+	// releasing the storage must not trigger evictions, the texture can be evicted right now
+	if (size != 0) {
+		budget.allocate(memory_budget::category::texture, size);
+		this->memory_size = size;
+	}
+
+	return old_size;
 }
 
-GLint opengl_texture::set_swizzeling(rasterimage::format f) const
+GLint opengl_texture::to_internal_format(rasterimage::format f)
 {
 	switch (f) {
 		default:
 			ASSERT(false)
 		case rasterimage::format::grey:
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-			assert_opengl_no_error();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
-			assert_opengl_no_error();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-			assert_opengl_no_error();
-
 			// GL_LUMINANCE is deprecated in OpenGL 3, so we use GL_RED
 			return GL_RED;
 		case rasterimage::format::greya:
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-			assert_opengl_no_error();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
-			assert_opengl_no_error();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-			assert_opengl_no_error();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_GREEN);
-			assert_opengl_no_error();
-
 			// GL_LUMINANCE_ALPHA is deprecated in OpenGL 3, so we use GL_RG
 			return GL_RG;
 		case rasterimage::format::rgb:
@@ -85,3 +122,71 @@ GLint opengl_texture::set_swizzeling(rasterimage::format f) const
 			return GL_RGBA;
 	}
 }
+
+GLenum opengl_texture::to_sized_internal_format(rasterimage::format f)
+{
+	switch (f) {
+		default:
+			ASSERT(false)
+		case rasterimage::format::grey:
+			return GL_R8;
+		case rasterimage::format::greya:
+			return GL_RG8;
+		case rasterimage::format::rgb:
+			return GL_RGB8;
+		case rasterimage::format::rgba:
+			return GL_RGBA8;
+	}
+}
+
+utki::span<const uint8_t> opengl_texture::get_texel_data(const rasterimage::image_variant& image)
+{
+	return std::visit(
+		[](const auto& im) -> utki::span<const uint8_t> {
+			if constexpr (sizeof(im.pixels().front().front()) != 1) {
+				throw std::invalid_argument("opengl_texture: non-8bit images are not supported");
+			} else {
+				auto data = im.pixels();
+				if (data.empty()) {
+					return {};
+				}
+				return utki::make_span(data.front().data(), data.size_bytes());
+			}
+		},
+		image.variant
+	);
+}
+
+void opengl_texture::set_parameter(GLenum pname, GLint value, GLenum target) const
+{
+	if (this->context.get().is_direct_state_access_enabled()) {
+		glTextureParameteri(this->tex, pname, value);
+	} else {
+		glTexParameteri(target, pname, value);
+	}
+	assert_opengl_no_error();
+}
+
+GLint opengl_texture::set_swizzeling(rasterimage::format f, GLenum target) const
+{
+	switch (f) {
+		default:
+			ASSERT(false)
+		case rasterimage::format::grey:
+			this->set_parameter(GL_TEXTURE_SWIZZLE_R, GL_RED, target);
+			this->set_parameter(GL_TEXTURE_SWIZZLE_G, GL_RED, target);
+			this->set_parameter(GL_TEXTURE_SWIZZLE_B, GL_RED, target);
+			break;
+		case rasterimage::format::greya:
+			this->set_parameter(GL_TEXTURE_SWIZZLE_R, GL_RED, target);
+			this->set_parameter(GL_TEXTURE_SWIZZLE_G, GL_RED, target);
+			this->set_parameter(GL_TEXTURE_SWIZZLE_B, GL_RED, target);
+			this->set_parameter(GL_TEXTURE_SWIZZLE_A, GL_GREEN, target);
+			break;
+		case rasterimage::format::rgb:
+		case rasterimage::format::rgba:
+			break;
+	}
+
+	return to_internal_format(f);
+}
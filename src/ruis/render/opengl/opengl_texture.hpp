@@ -21,15 +21,64 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <optional>
+
 #include <GL/glew.h>
 #include <rasterimage/image_variant.hpp>
+#include <utki/shared_ref.hpp>
+
+#include "context.hpp"
+#include "name_pool.hpp"
 
 namespace ruis::render::opengl {
 
 struct opengl_texture {
+	const utki::shared_ref<opengl::context> context;
+
 	GLuint tex = 0;
 
-	opengl_texture();
+private:
+	// storage of the texture which is recycled to the name pool on destruction
+	const std::optional<name_pool::texture_storage> storage;
+
+	// size of the texture storage accounted in the context's memory budget
+	size_t memory_size = 0;
+
+protected:
+	/**
+	 * @brief Whether the texel rows are stored top to bottom.
+	 * OpenGL texture coordinates have y-axis going upwards, i.e. the first row of the texel data
+	 * is the bottom row of the texture. Images have the first row at the top. Instead of flipping
+	 * the image rows before upload, the image can be uploaded as is, then the texturing shaders
+	 * flip the texture coordinates y-axis according to this flag.
+	 */
+	bool top_down = false;
+
+	/**
+	 * @brief Whether the texture was taken from the name pool along with its storage.
+	 * If true, the texture storage of the requested size and format is already allocated,
+	 * so the texel data can be uploaded with glTexSubImage2D().
+	 */
+	bool recycled = false;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * Creates texture without storage. The texture is deleted on destruction.
+	 * @param context - OpenGL context.
+	 * @param target - texture target.
+	 */
+	opengl_texture(utki::shared_ref<opengl::context> context, GLenum target = GL_TEXTURE_2D);
+
+	/**
+	 * @brief Constructor.
+	 * Reuses a recycled texture with the given storage from the context's name pool if there is one,
+	 * see the recycled flag. The texture is returned to the name pool on destruction.
+	 * The storage size is accounted in the context's memory budget.
+	 * @param context - OpenGL context.
+	 * @param storage - texture storage.
+	 */
+	opengl_texture(utki::shared_ref<opengl::context> context, const name_pool::texture_storage& storage);
 
 	opengl_texture(const opengl_texture&) = delete;
 	opengl_texture& operator=(const opengl_texture&) = delete;
@@ -41,10 +90,53 @@ struct opengl_texture {
 
 	void bind(unsigned unit_num) const;
 
-protected:
-	void set_active_texture(unsigned unit_num) const;
+	bool is_top_down() const noexcept
+	{
+		return this->top_down;
+	}
+
+	/**
+	 * @brief Get OpenGL internal texture format for image format.
+	 * @param f - image format.
+	 * @return internal texture format.
+	 */
+	static GLint to_internal_format(rasterimage::format f);
+
+	/**
+	 * @brief Get OpenGL sized internal texture format for image format.
+	 * Immutable texture storage requires sized internal format.
+	 * @param f - image format.
+	 * @return sized internal texture format.
+	 */
+	static GLenum to_sized_internal_format(rasterimage::format f);
+
+	/**
+	 * @brief Get texel data of an image.
+	 * @param image - image with 8 bits per channel.
+	 * @return texel data of the image, rows are top to bottom.
+	 * @throw std::invalid_argument - if the image is not 8 bits per channel.
+	 */
+	static utki::span<const uint8_t> get_texel_data(const rasterimage::image_variant& image);
 
-	GLint set_swizzeling(rasterimage::format f) const;
+protected:
+	/**
+	 * @brief Set texture parameter.
+	 * In case direct state access is not enabled, the texture must be bound to the active texture unit.
+	 * @param pname - parameter name.
+	 * @param value - parameter value.
+	 * @param target - texture target, used only when direct state access is not enabled.
+	 */
+	void set_parameter(GLenum pname, GLint value, GLenum target = GL_TEXTURE_2D) const;
+
+	GLint set_swizzeling(rasterimage::format f, GLenum target = GL_TEXTURE_2D) const;
+
+	/**
+	 * @brief Set size of the texture storage accounted in the context's memory budget.
+	 * Should be called before the storage is allocated, see memory_budget::allocate().
+	 * @param size - size of the texture storage in bytes, including all mipmap levels.
+	 * @return previously set size.
+	 */
+	size_t set_memory_size(size_t size);
 };
 
 } // namespace ruis::render::opengl
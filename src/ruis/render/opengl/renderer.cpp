@@ -74,26 +74,23 @@ renderer::renderer(std::unique_ptr<ruis::render::opengl::factory> factory) :
 							   .translate(-1, -1)
 							   // viewport edges: right = 1, bottom = 1
 							   .scale(2, 2)}
-	)
+	),
+	context([this]() {
+		ASSERT(dynamic_cast<opengl::factory*>(this->factory.get()))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		return static_cast<opengl::factory&>(*this->factory).context;
+	}())
 {
 	LOG([](auto& o) {
 		o << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 	})
 
 	// On some platforms the default framebuffer is not 0, so because of this
-	// check if default framebuffer value is saved or not everytime some
-	// framebuffer is going to be bound and save the value if needed.
-
-	// the old_fb variable is initialized via output argument, so no need to initialize
-	// it here
-
-	// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
-	GLint old_fb;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_fb);
+	// save the framebuffer which is bound at the moment of renderer creation.
+	this->default_framebuffer = this->context.get().get_framebuffer();
 	LOG([&](auto& o) {
-		o << "old_fb = " << old_fb << std::endl;
+		o << "default_framebuffer = " << this->default_framebuffer << std::endl;
 	})
-	this->default_framebuffer = GLuint(old_fb);
 
 #ifdef DEBUG
 	glEnable(GL_DEBUG_OUTPUT);
@@ -106,8 +103,7 @@ renderer::renderer(std::unique_ptr<ruis::render::opengl::factory> factory) :
 void renderer::set_framebuffer_internal(ruis::render::frame_buffer* fb)
 {
 	if (!fb) {
-		glBindFramebuffer(GL_FRAMEBUFFER, this->default_framebuffer);
-		assert_opengl_no_error();
+		this->context.get().set_framebuffer(this->default_framebuffer);
 		return;
 	}
 
@@ -115,34 +111,30 @@ void renderer::set_framebuffer_internal(ruis::render::frame_buffer* fb)
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
 	auto& ogl_fb = static_cast<frame_buffer&>(*fb);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, ogl_fb.fbo);
-	assert_opengl_no_error();
+	this->context.get().set_framebuffer(ogl_fb.fbo);
 }
 
 void renderer::clear_framebuffer_color()
 {
 	// Default clear color is RGBA = (0, 0, 0, 0);
-	glClear(GL_COLOR_BUFFER_BIT);
-	assert_opengl_no_error();
+	this->context.get().clear(GL_COLOR_BUFFER_BIT);
 }
 
 void renderer::clear_framebuffer_depth()
 {
 	// Default clear depth value is 1, see glClearDepth()
-	glClear(GL_DEPTH_BUFFER_BIT);
-	assert_opengl_no_error();
+	this->context.get().clear(GL_DEPTH_BUFFER_BIT);
 }
 
 void renderer::clear_framebuffer_stencil()
 {
 	// Default clear stencil value is 0, see glClearStencil()
-	glClear(GL_STENCIL_BUFFER_BIT);
-	assert_opengl_no_error();
+	this->context.get().clear(GL_STENCIL_BUFFER_BIT);
 }
 
 r4::vector2<uint32_t> renderer::to_window_coords(ruis::vec2 point) const
 {
-	auto vp = this->get_viewport();
+	const auto& vp = this->context.get().get_viewport();
 
 	point += ruis::vec2(1, 1);
 	point = max(point, {0, 0}); // clamp to >= 0
@@ -154,76 +146,37 @@ r4::vector2<uint32_t> renderer::to_window_coords(ruis::vec2 point) const
 
 bool renderer::is_scissor_enabled() const noexcept
 {
-	return glIsEnabled(GL_SCISSOR_TEST) ? true : false; // "? true : false" is to avoid warning under MSVC
+	return this->context.get().is_scissor_enabled();
 }
 
 void renderer::enable_scissor(bool enable)
 {
-	if (enable) {
-		glEnable(GL_SCISSOR_TEST);
-	} else {
-		glDisable(GL_SCISSOR_TEST);
-	}
+	this->context.get().enable_scissor(enable);
 }
 
 r4::rectangle<uint32_t> renderer::get_scissor() const
 {
-	std::array<GLint, 4> osb{};
-	glGetIntegerv(GL_SCISSOR_BOX, osb.data());
-
-#ifdef DEBUG
-	for (auto n : osb) {
-		ASSERT(n >= 0)
-	}
-#endif
-
-	return {
-		uint32_t(osb[0]), //
-		uint32_t(osb[1]),
-		uint32_t(osb[2]),
-		uint32_t(osb[3])
-	};
+	return this->context.get().get_scissor();
 }
 
 void renderer::set_scissor(r4::rectangle<uint32_t> r)
 {
-	glScissor(GLint(r.p.x()), GLint(r.p.y()), GLint(r.d.x()), GLint(r.d.y()));
-	assert_opengl_no_error();
+	this->context.get().set_scissor(r);
 }
 
 r4::rectangle<uint32_t> renderer::get_viewport() const
 {
-	std::array<GLint, 4> vp{};
-
-	glGetIntegerv(GL_VIEWPORT, vp.data());
-
-#ifdef DEBUG
-	for (auto n : vp) {
-		ASSERT(n >= 0)
-	}
-#endif
-
-	return {
-		uint32_t(vp[0]), //
-		uint32_t(vp[1]),
-		uint32_t(vp[2]),
-		uint32_t(vp[3])
-	};
+	return this->context.get().get_viewport();
 }
 
 void renderer::set_viewport(r4::rectangle<uint32_t> r)
 {
-	glViewport(GLint(r.p.x()), GLint(r.p.y()), GLint(r.d.x()), GLint(r.d.y()));
-	assert_opengl_no_error();
+	this->context.get().set_viewport(r);
 }
 
 void renderer::enable_blend(bool enable)
 {
-	if (enable) {
-		glEnable(GL_BLEND);
-	} else {
-		glDisable(GL_BLEND);
-	}
+	this->context.get().enable_blend(enable);
 }
 
 namespace {
@@ -255,7 +208,7 @@ void renderer::set_blend_func(
 	blend_factor dst_alpha
 )
 {
-	glBlendFuncSeparate(
+	this->context.get().set_blend_func({
 		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
 		blend_func[unsigned(src_color)],
 		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
@@ -264,19 +217,45 @@ void renderer::set_blend_func(
 		blend_func[unsigned(src_alpha)],
 		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
 		blend_func[unsigned(dst_alpha)]
-	);
+	});
 }
 
 bool renderer::is_depth_enabled() const noexcept
 {
-	return glIsEnabled(GL_DEPTH_TEST) ? true : false; // "? true : false" is to avoid warning under MSVC
+	return this->context.get().is_depth_enabled();
 }
 
 void renderer::enable_depth(bool enable)
 {
-	if (enable) {
-		glEnable(GL_DEPTH_TEST);
-	} else {
-		glDisable(GL_DEPTH_TEST);
-	}
+	this->context.get().enable_depth(enable);
+}
+
+void renderer::invalidate_state_cache()
+{
+	this->context.get().invalidate();
+}
+
+void renderer::enable_batching(bool enable)
+{
+	this->context.get().enable_batching(enable);
+}
+
+void renderer::flush()
+{
+	this->context.get().flush();
+}
+
+void renderer::enable_deferred_rendering(bool enable)
+{
+	this->context.get().enable_deferred_rendering(enable);
+}
+
+void renderer::end_frame()
+{
+	this->context.get().end_frame();
+}
+
+const context::frame_statistics& renderer::get_last_frame_statistics() const noexcept
+{
+	return this->context.get().get_last_frame_statistics();
 }
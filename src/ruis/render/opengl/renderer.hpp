@@ -26,6 +26,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <GL/glew.h>
 #include <ruis/render/renderer.hpp>
 
+#include "context.hpp"
 #include "factory.hpp"
 
 namespace ruis::render::opengl {
@@ -35,6 +36,8 @@ class renderer : public ruis::render::renderer
 	GLuint default_framebuffer;
 
 public:
+	const utki::shared_ref<opengl::context> context;
+
 	renderer(
 		std::unique_ptr<ruis::render::opengl::factory> factory = std::make_unique<ruis::render::opengl::factory>()
 	);
@@ -81,6 +84,60 @@ public:
 	bool is_depth_enabled() const noexcept override;
 
 	void enable_depth(bool enable) override;
+
+	/**
+	 * @brief Invalidate cached OpenGL state.
+	 * The renderer keeps a CPU-side shadow copy of the OpenGL state it sets,
+	 * so that state queries do not need to round-trip to the driver.
+	 * In case some foreign code changes the OpenGL state behind the renderer's back,
+	 * this function must be called before using the renderer again.
+	 */
+	void invalidate_state_cache();
+
+	/**
+	 * @brief Enable or disable draw call batching.
+	 * When enabled, consecutive draws done with the same shader, textures, uniforms and
+	 * renderer state are accumulated into a single draw call. Positions of the batched vertices
+	 * are transformed on the CPU. Only vertex arrays created while batching is enabled are batched.
+	 * Batching is disabled by default.
+	 * @param enable - whether to enable draw call batching.
+	 */
+	void enable_batching(bool enable);
+
+	/**
+	 * @brief Flush pending draws.
+	 * When batching or deferred rendering is enabled, this function must be called before
+	 * presenting the rendered frame, reading back the framebuffer contents or calling foreign OpenGL code.
+	 */
+	void flush();
+
+	/**
+	 * @brief Enable or disable deferred rendering.
+	 * When enabled, draws, framebuffer changes and clears are recorded and executed on flush().
+	 * The recorded draws are reordered to group the draws using same shader, texture and
+	 * renderer state, as long as this does not change the rendering result.
+	 * All the objects used by the recorded draws must stay alive until flush().
+	 * Shader uniforms are not recorded, so changing a uniform of a custom shader
+	 * executes the recorded commands first, which limits the reordering.
+	 * Deferred rendering is disabled by default.
+	 * @param enable - whether to enable deferred rendering.
+	 */
+	void enable_deferred_rendering(bool enable);
+
+	/**
+	 * @brief Finish the frame.
+	 * Flushes pending draws and collects the frame statistics.
+	 * Should be called once per frame before presenting the rendered frame.
+	 * Calling it is optional. In case it was not called, the frame is finished when the color buffer
+	 * of the default framebuffer is cleared at the beginning of the next frame, see context::end_frame().
+	 */
+	void end_frame();
+
+	/**
+	 * @brief Get statistics of the last finished frame.
+	 * @return statistics collected during the last finished frame.
+	 */
+	const context::frame_statistics& get_last_frame_statistics() const noexcept;
 };
 
 } // namespace ruis::render::opengl
@@ -21,13 +21,25 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "shader_base.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <GL/glew.h>
 #include <utki/debug.hpp>
 #include <utki/string.hpp>
 
+#include "batcher.hpp"
+#include "command_list.hpp"
+#include "deletion_queue.hpp"
 #include "index_buffer.hpp"
+#include "stream_buffer.hpp"
+#include "texture_2d.hpp"
+#include "transform_buffer.hpp"
 #include "util.hpp"
 #include "vertex_array.hpp"
 #include "vertex_buffer.hpp"
@@ -96,6 +108,78 @@ bool check_for_link_errors(GLuint program)
 	return false;
 }
 
+bool is_identifier_char(char c)
+{
+	return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// checks if the shader code has "mat4 matrix" declaration
+bool is_matrix_declared(const std::string& code)
+{
+	for (auto pos = code.find("mat4"); pos != std::string::npos; pos = code.find("mat4", pos + 1)) {
+		if (pos != 0 && is_identifier_char(code[pos - 1])) {
+			continue;
+		}
+
+		auto name_pos = code.find_first_not_of(" \t\r\n", pos + std::strlen("mat4"));
+		if (name_pos == pos + std::strlen("mat4") || name_pos == std::string::npos) {
+			continue;
+		}
+
+		constexpr std::string_view name = "matrix";
+		auto name_end = name_pos + name.size();
+		if (code.compare(name_pos, name.size(), name) == 0 &&
+			(name_end == code.size() || !is_identifier_char(code[name_end])))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// returns position after the leading #version and #extension directives
+size_t find_declarations_begin(const std::string& code)
+{
+	size_t ret = 0;
+	for (size_t line_begin = 0; line_begin < code.size();) {
+		auto line_end = std::min(code.find('\n', line_begin), code.size());
+
+		auto first = code.find_first_not_of(" \t\r", line_begin);
+		if (first < line_end) {
+			if (code.compare(first, 1, "#") == 0) {
+				auto directive_begin = std::min(code.find_first_not_of(" \t", first + 1), code.size());
+				if (code.compare(directive_begin, std::strlen("version"), "version") != 0 &&
+					code.compare(directive_begin, std::strlen("extension"), "extension") != 0)
+				{
+					break;
+				}
+				ret = line_end;
+			} else if (code.compare(first, 2, "//") != 0) {
+				break;
+			}
+		}
+
+		line_begin = line_end + 1;
+	}
+	return ret;
+}
+
+std::string make_vertex_shader_code(const context& ctx, const char* code)
+{
+	std::string ret = code;
+
+	if (is_matrix_declared(ret)) {
+		return ret;
+	}
+
+	// the declaration must follow the #version and #extension directives of the shader
+	ret.insert(
+		find_declarations_begin(ret),
+		ctx.get_transform_buffer() ? utki::cat('\n', transform_buffer::glsl_declaration) : "\nuniform mat4 matrix;\n"
+	);
+
+	return ret;
+}
 } // namespace
 
 shader_wrapper::shader_wrapper(const char* code, GLenum type) :
@@ -155,10 +239,88 @@ program_wrapper::program_wrapper(const char* vertex_shader_code, const char* fra
 	}
 }
 
-shader_base::shader_base(const char* vertex_shader_code, const char* fragment_shader_code) :
-	program(vertex_shader_code, fragment_shader_code),
-	matrix_uniform(this->get_uniform("matrix"))
-{}
+shader_base::shader_base(
+	utki::shared_ref<opengl::context> context, //
+	const char* vertex_shader_code,
+	const char* fragment_shader_code
+) :
+	context(std::move(context)),
+	program(make_vertex_shader_code(this->context.get(), vertex_shader_code).c_str(), fragment_shader_code),
+	matrix_uniform([this]() {
+		if (this->context.get().get_transform_buffer()) {
+			GLuint block = glGetUniformBlockIndex(this->program.p, transform_buffer::block_name);
+			if (block != GL_INVALID_INDEX) {
+				glUniformBlockBinding(this->program.p, block, transform_buffer::binding_point);
+				assert_opengl_no_error();
+				return GLint(-1);
+			}
+		}
+		// uniform blocks are not supported or the shader declares the matrix by itself
+		return this->get_uniform("matrix");
+	}()),
+	texture_orientation_uniform(glGetUniformLocation(this->program.p, "texture0_top_down"))
+{
+	// Similarly to the attributes naming convention "aN", the sampler uniforms
+	// named "textureN" are bound to the texture unit N. Since the texture unit
+	// numbers never change, the sampler uniforms are set only once here.
+
+	// the variable is initialized via output argument, so no need to initialize
+	// it here
+
+	// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+	GLint max_num_texture_units;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &max_num_texture_units);
+	ASSERT(max_num_texture_units >= 0)
+
+	this->bind();
+
+	for (GLint i = 0; i != max_num_texture_units; ++i) {
+		std::stringstream ss;
+		ss << "texture" << i;
+		GLint id = glGetUniformLocation(this->program.p, ss.str().c_str());
+		if (id < 0) {
+			continue;
+		}
+		this->set_uniform_sampler(id, i);
+	}
+}
+
+shader_base::~shader_base()
+{
+	if (!this->context.get().is_context_thread()) {
+		auto& queue = this->context.get().get_deletion_queue();
+		queue.push({.type = deletion_queue::object_type::program, .name = this->program.p});
+		queue.push({.type = deletion_queue::object_type::shader, .name = this->program.vertex_shader.s});
+		queue.push({.type = deletion_queue::object_type::shader, .name = this->program.fragment_shader.s});
+
+		// the names will be deleted by the context, zero names are silently ignored by glDelete*()
+		this->program.p = 0;
+		this->program.vertex_shader.s = 0;
+		this->program.fragment_shader.s = 0;
+		return;
+	}
+
+	this->context.get().forget_program(this->program.p);
+}
+
+bool shader_base::update_uniform_cache(GLint id, utki::span<const float> value) const
+{
+	ASSERT(value.size() <= std::tuple_size_v<decltype(uniform_value::value)>)
+
+	auto i = std::find_if(this->uniform_cache.begin(), this->uniform_cache.end(), [&id](const auto& v) {
+		return v.id == id;
+	});
+
+	if (i == this->uniform_cache.end()) {
+		i = this->uniform_cache.insert(i, {id, {}});
+	} else if (std::memcmp(i->value.data(), value.data(), value.size_bytes()) == 0) {
+		// bit-identical value was already uploaded
+		return false;
+	}
+
+	std::copy(value.begin(), value.end(), i->value.begin());
+	return true;
+}
 
 GLint shader_base::get_uniform(const char* n)
 {
@@ -169,20 +331,85 @@ GLint shader_base::get_uniform(const char* n)
 	return ret;
 }
 
+void shader_base::set_matrix(const r4::matrix4<float>& m) const
+{
+	if (this->matrix_uniform < 0) {
+		// the matrix is in the uniform block
+		this->context.get().set_transform(m);
+		return;
+	}
+	this->set_uniform_matrix4f(this->matrix_uniform, m);
+}
+
 void shader_base::render(const r4::matrix4<float>& m, const ruis::render::vertex_array& va) const
 {
-	ASSERT(this->is_bound())
+	this->render(m, va, draw_parameters());
+}
 
-	ASSERT(dynamic_cast<const index_buffer*>(&va.indices.get()))
+void shader_base::render(
+	const r4::matrix4<float>& m,
+	const ruis::render::vertex_array& va,
+	const draw_parameters& params
+) const
+{
+	ASSERT(dynamic_cast<const vertex_array*>(&va))
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
-	const auto& ivbo = static_cast<const index_buffer&>(va.indices.get());
+	const auto& ogl_va = static_cast<const vertex_array&>(va);
 
-	this->set_matrix(m);
+	if (auto commands = this->context.get().get_command_list()) {
+		commands->record_draw(*this, m, ogl_va, params);
+		return;
+	}
+
+	this->apply(params);
+	this->draw(m, va);
+}
+
+void shader_base::apply(const draw_parameters& params) const
+{
+	if (params.texture) {
+		params.texture->bind(0);
+	}
+
+	this->bind();
+
+	if (params.color_uniform >= 0) {
+		const auto& c = params.color;
+		this->set_uniform4f(params.color_uniform, c.x(), c.y(), c.z(), c.w());
+	}
+
+	if (params.texture && this->texture_orientation_uniform >= 0) {
+		this->set_uniform1f(this->texture_orientation_uniform, params.texture->is_top_down() ? 1 : 0);
+	}
+}
+
+void shader_base::draw(const r4::matrix4<float>& m, const ruis::render::vertex_array& va) const
+{
+	ASSERT(this->is_bound())
+
+	auto& ctx = this->context.get();
+
+	++ctx.get_draw_statistics().num_draws;
 
 	ASSERT(dynamic_cast<const vertex_array*>(&va))
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
 	const auto& ogl_va = static_cast<const vertex_array&>(va);
 
+	if (auto batch = ctx.get_batcher()) {
+		if (batch->append(*this, m, ogl_va)) {
+			++ctx.get_draw_statistics().num_batched_draws;
+			return;
+		}
+		// the draw cannot be batched, draw pending batch before drawing directly
+		batch->flush();
+	}
+
+	ASSERT(dynamic_cast<const index_buffer*>(&va.indices.get()))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ivbo = static_cast<const index_buffer&>(va.indices.get());
+
+	this->set_matrix(m);
+
 	if (GLEW_ARB_vertex_array_object) {
 		glBindVertexArray(ogl_va.vao);
 		assert_opengl_no_error();
@@ -193,9 +420,16 @@ void shader_base::render(const r4::matrix4<float>& m, const ruis::render::vertex
 	//	TRACE(<< "ivbo.elementsCount = " << ivbo.elementsCount << "
 	// ivbo.elementType = " << ivbo.elementType << std::endl)
 
-	glDrawElements(mode_to_gl_mode(va.rendering_mode), ivbo.elements_count, ivbo.element_type, nullptr);
+	glDrawElements(
+		mode_to_gl_mode(va.rendering_mode),
+		ogl_va.num_indices,
+		ivbo.element_type,
+		ivbo.get_offset_pointer()
+	);
 	assert_opengl_no_error();
 
+	++ctx.get_draw_statistics().num_draw_calls;
+
 	if (GLEW_ARB_vertex_array_object) {
 		// For some reason on linux when leaving bound vertex array after done with
 		// rendering a frame, the vertex array can become corrupted in some
@@ -205,3 +439,281 @@ void shader_base::render(const r4::matrix4<float>& m, const ruis::render::vertex
 		assert_opengl_no_error();
 	}
 }
+
+namespace {
+// instance data is expected to be already written to the stream buffer at the given offset
+void setup_instance_attributes(
+	const stream_buffer& instance_stream,
+	size_t instance_data_offset,
+	GLuint first_instance_attribute,
+	GLuint num_instance_attributes
+)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instance_stream.buffer);
+	assert_opengl_no_error();
+
+	auto stride = GLsizei(num_instance_attributes * sizeof(r4::vector4<float>));
+
+	for (GLuint i = 0; i != num_instance_attributes; ++i) {
+		GLuint attr = first_instance_attribute + i;
+		glVertexAttribPointer(
+			attr,
+			4,
+			GL_FLOAT,
+			GL_FALSE,
+			stride,
+			// NOLINTNEXTLINE(performance-no-int-to-ptr)
+			reinterpret_cast<const GLvoid*>(instance_data_offset + i * sizeof(r4::vector4<float>))
+		);
+		assert_opengl_no_error();
+		glEnableVertexAttribArray(attr);
+		assert_opengl_no_error();
+		glVertexAttribDivisorARB(attr, 1);
+		assert_opengl_no_error();
+	}
+}
+
+// restore the per-vertex attributes state, in case of VAO it is part of the VAO state
+void reset_instance_attributes(GLuint first_instance_attribute, GLuint num_instance_attributes)
+{
+	for (GLuint i = 0; i != num_instance_attributes; ++i) {
+		GLuint attr = first_instance_attribute + i;
+		glVertexAttribDivisorARB(attr, 0);
+		assert_opengl_no_error();
+		glDisableVertexAttribArray(attr);
+		assert_opengl_no_error();
+	}
+}
+
+// Set attributes of a single instance as constant vertex attributes.
+// The attribute arrays are expected to be disabled.
+void set_constant_attributes(utki::span<const r4::vector4<float>> attributes, GLuint first_attribute)
+{
+	for (GLuint i = 0; i != attributes.size(); ++i) {
+		glVertexAttrib4fv(first_attribute + i, attributes[i].data());
+		assert_opengl_no_error();
+	}
+}
+} // namespace
+
+bool shader_base::is_instancing_supported() noexcept
+{
+	return GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+}
+
+void shader_base::render_instanced(
+	const r4::matrix4<float>& m,
+	const ruis::render::vertex_array& va,
+	const draw_parameters& params,
+	utki::span<const r4::vector4<float>> instance_data,
+	GLuint first_instance_attribute,
+	GLuint num_instance_attributes
+) const
+{
+	ASSERT(num_instance_attributes != 0)
+	ASSERT(instance_data.size() % num_instance_attributes == 0)
+
+	auto num_instances = instance_data.size() / num_instance_attributes;
+	if (num_instances == 0) {
+		return;
+	}
+
+	auto& ctx = this->context.get();
+
+	// instanced draws are not recorded, execute recorded commands to keep the drawing order
+	ctx.flush();
+
+	this->apply(params);
+
+	ctx.flush_batch();
+
+	ctx.get_draw_statistics().num_draws += num_instances;
+
+	ASSERT(dynamic_cast<const vertex_array*>(&va))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ogl_va = static_cast<const vertex_array&>(va);
+
+	ASSERT(dynamic_cast<const index_buffer*>(&va.indices.get()))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	const auto& ivbo = static_cast<const index_buffer&>(va.indices.get());
+
+	this->set_matrix(m);
+
+	// write instance data before binding the vertex array object,
+	// because the first access to the stream buffer creates and binds the buffer
+	size_t instance_data_offset = 0;
+	if (is_instancing_supported()) {
+		instance_data_offset = ctx.get_vertex_stream().write(instance_data);
+	}
+
+	if (GLEW_ARB_vertex_array_object) {
+		glBindVertexArray(ogl_va.vao);
+		assert_opengl_no_error();
+	} else {
+		ogl_va.bind_buffers();
+	}
+
+	auto gl_mode = mode_to_gl_mode(va.rendering_mode);
+
+	if (is_instancing_supported()) {
+		setup_instance_attributes(
+			ctx.get_vertex_stream(),
+			instance_data_offset,
+			first_instance_attribute,
+			num_instance_attributes
+		);
+
+		glDrawElementsInstancedARB(
+			gl_mode,
+			ogl_va.num_indices,
+			ivbo.element_type,
+			ivbo.get_offset_pointer(),
+			GLsizei(num_instances)
+		);
+		assert_opengl_no_error();
+
+		++ctx.get_draw_statistics().num_draw_calls;
+
+		reset_instance_attributes(first_instance_attribute, num_instance_attributes);
+	} else {
+		// Per-instance attribute arrays are disabled, so the shader gets
+		// the constant vertex attribute values set with glVertexAttrib4fv().
+		for (auto i = instance_data.begin(); i != instance_data.end(); i += num_instance_attributes) {
+			set_constant_attributes(utki::make_span(&*i, num_instance_attributes), first_instance_attribute);
+
+			glDrawElements(gl_mode, ogl_va.num_indices, ivbo.element_type, ivbo.get_offset_pointer());
+			assert_opengl_no_error();
+
+			++ctx.get_draw_statistics().num_draw_calls;
+		}
+	}
+
+	if (GLEW_ARB_vertex_array_object) {
+		// see comment in shader_base::draw() on why unbinding the vertex array
+		glBindVertexArray(0);
+		assert_opengl_no_error();
+	}
+}
+
+void shader_base::render_multi(
+	const r4::matrix4<float>& m,
+	const draw_parameters& params,
+	const geometry_pool& pool,
+	utki::span<const geometry_pool::range> ranges,
+	utki::span<const r4::vector4<float>> instance_data,
+	GLuint first_instance_attribute,
+	GLuint num_instance_attributes
+) const
+{
+	ASSERT(num_instance_attributes != 0)
+	ASSERT(instance_data.size() == ranges.size() * num_instance_attributes)
+
+	if (ranges.empty()) {
+		return;
+	}
+
+	auto& ctx = this->context.get();
+
+	// multi-draws are not recorded, execute recorded commands to keep the drawing order
+	ctx.flush();
+
+	this->apply(params);
+
+	ctx.flush_batch();
+
+	ctx.get_draw_statistics().num_draws += ranges.size();
+
+	this->set_matrix(m);
+
+	bool use_indirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance && is_instancing_supported();
+
+	// write per-draw data before binding the vertex array object,
+	// because the first access to the stream buffer creates and binds the buffer
+	size_t instance_data_offset = 0;
+	if (use_indirect) {
+		instance_data_offset = ctx.get_vertex_stream().write(instance_data);
+	}
+
+	glBindVertexArray(pool.vao);
+	assert_opengl_no_error();
+
+	auto gl_mode = mode_to_gl_mode(pool.rendering_mode);
+	auto index_size = pool.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	if (use_indirect) {
+		// Each draw is a single instance draw, the per-draw attributes are fetched
+		// from the instance data array by the base instance number.
+		setup_instance_attributes(
+			ctx.get_vertex_stream(),
+			instance_data_offset,
+			first_instance_attribute,
+			num_instance_attributes
+		);
+
+		// layout of the indirect draw command is defined by OpenGL
+		struct draw_elements_indirect_command {
+			GLuint count;
+			GLuint instance_count;
+			GLuint first_index;
+			GLint base_vertex;
+			GLuint base_instance;
+		};
+
+		std::vector<draw_elements_indirect_command> commands;
+		commands.reserve(ranges.size());
+		for (const auto& r : ranges) {
+			commands.push_back({
+				.count = GLuint(r.num_indices),
+				.instance_count = 1,
+				.first_index = r.first_index,
+				.base_vertex = r.base_vertex,
+				.base_instance = GLuint(commands.size())
+			});
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, pool.indirect_buffer);
+		assert_opengl_no_error();
+
+		// upload with glBufferData() so that the driver can orphan the last frame's buffer storage
+		glBufferData(
+			GL_DRAW_INDIRECT_BUFFER,
+			GLsizeiptr(commands.size() * sizeof(decltype(commands)::value_type)),
+			commands.data(),
+			GL_STREAM_DRAW
+		);
+		assert_opengl_no_error();
+
+		glMultiDrawElementsIndirect(gl_mode, pool.index_type, nullptr, GLsizei(commands.size()), 0);
+		assert_opengl_no_error();
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		assert_opengl_no_error();
+
+		++ctx.get_draw_statistics().num_draw_calls;
+
+		reset_instance_attributes(first_instance_attribute, num_instance_attributes);
+	} else {
+		// Draw one by one, but without switching vertex arrays.
+		auto attrs = instance_data.begin();
+		for (const auto& r : ranges) {
+			set_constant_attributes(utki::make_span(&*attrs, num_instance_attributes), first_instance_attribute);
+			attrs += num_instance_attributes;
+
+			glDrawElementsBaseVertex(
+				gl_mode,
+				r.num_indices,
+				pool.index_type,
+				// NOLINTNEXTLINE(performance-no-int-to-ptr)
+				reinterpret_cast<const GLvoid*>(r.first_index * index_size),
+				r.base_vertex
+			);
+			assert_opengl_no_error();
+
+			++ctx.get_draw_statistics().num_draw_calls;
+		}
+	}
+
+	// see comment in shader_base::draw() on why unbinding the vertex array
+	glBindVertexArray(0);
+	assert_opengl_no_error();
+}
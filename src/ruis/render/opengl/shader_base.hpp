@@ -28,11 +28,17 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <ruis/render/vertex_array.hpp>
 #include <utki/config.hpp>
 #include <utki/debug.hpp>
+#include <utki/shared_ref.hpp>
+#include <utki/span.hpp>
 
+#include "context.hpp"
+#include "geometry_pool.hpp"
 #include "util.hpp"
 
 namespace ruis::render::opengl {
 
+class texture_2d;
+
 struct shader_wrapper {
 	GLuint s;
 	shader_wrapper(const char* code, GLenum type);
@@ -70,12 +76,54 @@ struct program_wrapper {
 
 class shader_base
 {
+	friend class batcher;
+	friend class command_list;
+
+protected:
+	const utki::shared_ref<opengl::context> context;
+
+private:
 	program_wrapper program;
 
 	const GLint matrix_uniform;
 
+	// "float texture0_top_down" uniform, negative if the shader does not have it, see opengl_texture::top_down
+	const GLint texture_orientation_uniform;
+
+	struct uniform_value {
+		GLint id;
+		std::array<float, 16> value; // big enough to hold 4x4 matrix
+	};
+
+	// last values uploaded to the uniforms of the program
+	mutable std::vector<uniform_value> uniform_cache;
+
+	// returns true if the uniform value differs from the cached one
+	bool update_uniform_cache(GLint id, utki::span<const float> value) const;
+
 public:
-	shader_base(const char* vertex_shader_code, const char* fragment_shader_code);
+	/**
+	 * @brief Constructor.
+	 * The transformation matrix uniform "mat4 matrix" is declared by the shader_base, unless the vertex shader
+	 * code declares it. The declaration is inserted after the #version and #extension directives of the code.
+	 * In case the shader program has "float texture0_top_down" uniform, it is set to 1.0
+	 * for the textures with top to bottom rows order and to 0.0 otherwise,
+	 * so that the shader can flip the texture coordinates accordingly, see opengl_texture::top_down.
+	 * Textures created from borrowed texel data, dynamic textures, evictable textures, texture atlas pages and,
+	 * if enabled with factory::enable_top_down_image_textures(), image textures are top-down.
+	 * Shaders without the uniform draw those textures upside down.
+	 * Depending on OpenGL capabilities, the declared matrix is either a classic uniform or a member
+	 * of the uniform block shared by all the shader programs, see transform_buffer.
+	 * The matrix declared by the vertex shader code itself is set as a classic uniform.
+	 * @param context - OpenGL context.
+	 * @param vertex_shader_code - vertex shader code.
+	 * @param fragment_shader_code - fragment shader code.
+	 */
+	shader_base(
+		utki::shared_ref<opengl::context> context, //
+		const char* vertex_shader_code,
+		const char* fragment_shader_code
+	);
 
 	shader_base(const shader_base&) = delete;
 	shader_base& operator=(const shader_base&) = delete;
@@ -83,24 +131,19 @@ public:
 	shader_base(shader_base&&) = delete;
 	shader_base& operator=(shader_base&&) = delete;
 
-	virtual ~shader_base() = default;
+	virtual ~shader_base();
 
 protected:
 	GLint get_uniform(const char* n);
 
 	void bind() const
 	{
-		glUseProgram(this->program.p);
-		assert_opengl_no_error();
+		this->context.get().use_program(this->program.p);
 	}
 
 	bool is_bound() const noexcept
 	{
-		GLint prog = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
-
-		ASSERT(prog >= 0)
-		return GLuint(prog) == this->program.p;
+		return this->context.get().get_current_program() == this->program.p;
 	}
 
 	void set_uniform_sampler(GLint id, GLint texture_unit_num) const
@@ -111,38 +154,68 @@ protected:
 
 	void set_uniform_matrix3f(GLint id, const r4::matrix3<float>& m) const
 	{
+		if (!this->update_uniform_cache(id, utki::make_span(m.front().data(), m.size() * m.front().size()))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
 		glUniformMatrix3fv(id, 1, GL_TRUE, m.front().data());
 		assert_opengl_no_error();
 	}
 
 	void set_uniform_matrix4f(GLint id, const r4::matrix4<float>& m) const
 	{
+		if (!this->update_uniform_cache(id, utki::make_span(m.front().data(), m.size() * m.front().size()))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
 		glUniformMatrix4fv(id, 1, GL_TRUE, m.front().data());
 		assert_opengl_no_error();
 	}
 
+	void set_uniform1f(GLint id, float x) const
+	{
+		if (!this->update_uniform_cache(id, utki::make_span(&x, 1))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
+		glUniform1f(id, x);
+		assert_opengl_no_error();
+	}
+
 	void set_uniform2f(GLint id, float x, float y) const
 	{
+		std::array<float, 2> v = {x, y};
+		if (!this->update_uniform_cache(id, utki::make_span(v.data(), v.size()))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
 		glUniform2f(id, x, y);
 		assert_opengl_no_error();
 	}
 
 	void set_uniform3f(GLint id, float x, float y, float z) const
 	{
+		std::array<float, 3> v = {x, y, z};
+		if (!this->update_uniform_cache(id, utki::make_span(v.data(), v.size()))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
 		glUniform3f(id, x, y, z);
 		assert_opengl_no_error();
 	}
 
 	void set_uniform4f(GLint id, float x, float y, float z, float a) const
 	{
+		std::array<float, 4> v = {x, y, z, a};
+		if (!this->update_uniform_cache(id, utki::make_span(v.data(), v.size()))) {
+			return;
+		}
+		this->context.get().flush_before_uniform_change();
 		glUniform4f(id, x, y, z, a);
 		assert_opengl_no_error();
 	}
 
-	void set_matrix(const r4::matrix4<float>& m) const
-	{
-		this->set_uniform_matrix4f(this->matrix_uniform, m);
-	}
+	void set_matrix(const r4::matrix4<float>& m) const;
 
 	static const std::array<GLenum, size_t(ruis::render::vertex_array::mode::enum_size)> mode_map;
 
@@ -152,7 +225,104 @@ protected:
 		return mode_map[unsigned(mode)];
 	}
 
+	/**
+	 * @brief Per-draw parameters of the shader.
+	 */
+	struct draw_parameters {
+		/**
+		 * @brief Texture to bind to the texture unit 0.
+		 * nullptr if the shader does not use textures.
+		 */
+		const texture_2d* texture = nullptr;
+
+		/**
+		 * @brief Color uniform id.
+		 * Negative if the shader does not have color uniform.
+		 */
+		GLint color_uniform = -1;
+
+		r4::vector4<float> color{1, 1, 1, 1};
+	};
+
+	/**
+	 * @brief Render vertex array.
+	 * In deferred rendering mode the draw is recorded to the context's command list,
+	 * otherwise it is drawn immediately.
+	 * @param m - transformation matrix.
+	 * @param va - vertex array to render.
+	 * @param params - per-draw shader parameters.
+	 */
+	void render(
+		const r4::matrix4<float>& m,
+		const ruis::render::vertex_array& va,
+		const draw_parameters& params
+	) const;
+
+	/**
+	 * @brief Render vertex array with default per-draw parameters.
+	 * @param m - transformation matrix.
+	 * @param va - vertex array to render.
+	 */
 	void render(const r4::matrix4<float>& m, const ruis::render::vertex_array& va) const;
+
+	/**
+	 * @brief Render multiple instances of vertex array.
+	 * Each instance has a number of per-instance vec4 attributes, which are taken from the
+	 * instance data array and assigned to consecutive attribute locations.
+	 * In case instanced arrays are not supported by OpenGL, the instances are drawn one by one,
+	 * with per-instance attributes set as constant vertex attributes.
+	 * @param m - transformation matrix, common for all instances.
+	 * @param va - vertex array to render.
+	 * @param params - per-draw shader parameters, common for all instances.
+	 * @param instance_data - per-instance attributes of all instances.
+	 * @param first_instance_attribute - attribute location of the first per-instance attribute.
+	 * @param num_instance_attributes - number of per-instance attributes.
+	 */
+	void render_instanced(
+		const r4::matrix4<float>& m,
+		const ruis::render::vertex_array& va,
+		const draw_parameters& params,
+		utki::span<const r4::vector4<float>> instance_data,
+		GLuint first_instance_attribute,
+		GLuint num_instance_attributes
+	) const;
+
+	/**
+	 * @brief Render multiple geometry pool ranges.
+	 * If OpenGL supports multi-draw indirect, the ranges are drawn with a single
+	 * glMultiDrawElementsIndirect() call, each range being a single instance draw.
+	 * Per-draw attributes are vec4 instance attributes, which are taken from the instance data array,
+	 * the same way as in render_instanced().
+	 * Otherwise, the ranges are drawn one by one with the pool's vertex array bound all the time.
+	 * @param m - transformation matrix, common for all draws.
+	 * @param params - per-draw shader parameters, common for all draws.
+	 * @param pool - geometry pool to draw ranges from.
+	 * @param ranges - ranges of the geometry pool to draw.
+	 * @param instance_data - per-draw attributes of all draws.
+	 * @param first_instance_attribute - attribute location of the first per-draw attribute.
+	 * @param num_instance_attributes - number of per-draw attributes.
+	 */
+	void render_multi(
+		const r4::matrix4<float>& m,
+		const draw_parameters& params,
+		const geometry_pool& pool,
+		utki::span<const geometry_pool::range> ranges,
+		utki::span<const r4::vector4<float>> instance_data,
+		GLuint first_instance_attribute,
+		GLuint num_instance_attributes
+	) const;
+
+	/**
+	 * @brief Check if instanced drawing is supported by OpenGL.
+	 * @return true if OpenGL supports instanced arrays and instanced draw calls.
+	 */
+	static bool is_instancing_supported() noexcept;
+
+private:
+	// bind the program and set per-draw parameters
+	void apply(const draw_parameters& params) const;
+
+	void draw(const r4::matrix4<float>& m, const ruis::render::vertex_array& va) const;
 };
 
 } // namespace ruis::render::opengl
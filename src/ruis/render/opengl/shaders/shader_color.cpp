@@ -23,13 +23,12 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-shader_color::shader_color() :
+shader_color::shader_color(utki::shared_ref<opengl::context> context) :
 	shader_base(
+		std::move(context),
 		R"qwertyuiop(
 			attribute vec4 a0;
 
-			uniform mat4 matrix;
-			
 			void main(void){
 				gl_Position = matrix * a0;
 			}
@@ -51,9 +50,9 @@ void shader_color::render(
 	r4::vector4<float> color
 ) const
 {
-	this->bind();
+	draw_parameters params;
+	params.color_uniform = this->color_uniform;
+	params.color = color;
 
-	this->set_uniform4f(this->color_uniform, color.x(), color.y(), color.z(), color.w());
-
-	this->shader_base::render(m, va);
+	this->shader_base::render(m, va, params);
 }
@@ -0,0 +1,108 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "shader_color_instanced.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+constexpr GLuint first_instance_attribute = 2;
+constexpr GLuint num_instance_attributes = 5;
+} // namespace
+
+static_assert(
+	sizeof(shader_color_instanced::instance) == num_instance_attributes * sizeof(r4::vector4<float>),
+	"instance must be an array of vec4 attributes"
+);
+
+shader_color_instanced::shader_color_instanced(utki::shared_ref<opengl::context> context) :
+	shader_base(
+		std::move(context),
+		R"qwertyuiop(
+			attribute vec4 a0; // position
+
+			// Per-instance matrix. Takes attribute locations 2-5.
+			// The matrix rows are passed as the mat4 columns, i.e. the matrix is transposed.
+			attribute mat4 a2;
+
+			attribute vec4 a6; // per-instance color
+
+			varying vec4 clr;
+
+			void main(void){
+				// multiply by transposed matrix from the left
+				gl_Position = matrix * (a0 * a2);
+				clr = a6;
+			}
+		)qwertyuiop",
+		R"qwertyuiop(
+			varying vec4 clr;
+
+			void main(void){
+				gl_FragColor = clr;
+			}
+		)qwertyuiop"
+	)
+{}
+
+void shader_color_instanced::render(
+	const r4::matrix4<float>& m,
+	const ruis::render::vertex_array& va,
+	utki::span<const instance> instances
+) const
+{
+	this->render_instanced(
+		m,
+		va,
+		draw_parameters(),
+		utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<const r4::vector4<float>*>(instances.data()),
+			instances.size() * num_instance_attributes
+		),
+		first_instance_attribute,
+		num_instance_attributes
+	);
+}
+
+void shader_color_instanced::render(
+	const r4::matrix4<float>& m,
+	const geometry_pool& pool,
+	utki::span<const geometry_pool::range> ranges,
+	utki::span<const instance> instances
+) const
+{
+	ASSERT(ranges.size() == instances.size())
+
+	this->render_multi(
+		m,
+		draw_parameters(),
+		pool,
+		ranges,
+		utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<const r4::vector4<float>*>(instances.data()),
+			instances.size() * num_instance_attributes
+		),
+		first_instance_attribute,
+		num_instance_attributes
+	);
+}
@@ -0,0 +1,82 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <ruis/render/vertex_array.hpp>
+
+#include "../shader_base.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Instanced variant of shader_color.
+ * Draws multiple instances of a vertex array with per-instance transformation matrix and color.
+ */
+class shader_color_instanced : public shader_base
+{
+public:
+	struct instance {
+		r4::matrix4<float> matrix;
+		r4::vector4<float> color;
+	};
+
+	shader_color_instanced(utki::shared_ref<opengl::context> context);
+
+	shader_color_instanced(const shader_color_instanced&) = delete;
+	shader_color_instanced& operator=(const shader_color_instanced&) = delete;
+
+	shader_color_instanced(shader_color_instanced&&) = delete;
+	shader_color_instanced& operator=(shader_color_instanced&&) = delete;
+
+	~shader_color_instanced() override = default;
+
+	/**
+	 * @brief Render instances of vertex array.
+	 * Each instance is rendered with m * instance.matrix transformation and instance.color color.
+	 * @param m - transformation matrix, common for all instances.
+	 * @param va - vertex array to render.
+	 * @param instances - instances to render.
+	 */
+	void render(
+		const r4::matrix4<float>& m,
+		const ruis::render::vertex_array& va,
+		utki::span<const instance> instances
+	) const;
+
+	/**
+	 * @brief Render geometry pool ranges.
+	 * Each range is rendered with m * instance.matrix transformation and instance.color color
+	 * of the corresponding instance, see shader_base::render_multi().
+	 * @param m - transformation matrix, common for all ranges.
+	 * @param pool - geometry pool to render ranges from.
+	 * @param ranges - ranges to render.
+	 * @param instances - per-range matrices and colors, one for each range.
+	 */
+	void render(
+		const r4::matrix4<float>& m,
+		const geometry_pool& pool,
+		utki::span<const geometry_pool::range> ranges,
+		utki::span<const instance> instances
+	) const;
+};
+
+} // namespace ruis::render::opengl
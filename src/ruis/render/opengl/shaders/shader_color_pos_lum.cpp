@@ -23,14 +23,13 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-shader_color_pos_lum::shader_color_pos_lum() :
+shader_color_pos_lum::shader_color_pos_lum(utki::shared_ref<opengl::context> context) :
 	shader_base(
+		std::move(context),
 		R"qwertyuiop(
 			attribute vec4 a0;
 			attribute float a1;
 
-			uniform mat4 matrix;
-
 			varying float lum;
 
 			void main(void){
@@ -57,9 +56,9 @@ void shader_color_pos_lum::render(
 	r4::vector4<float> color
 ) const
 {
-	this->bind();
-
-	this->set_uniform4f(this->color_uniform, color.x(), color.y(), color.z(), color.w());
+	draw_parameters params;
+	params.color_uniform = this->color_uniform;
+	params.color = color;
 
-	this->shader_base::render(m, va);
+	this->shader_base::render(m, va, params);
 }
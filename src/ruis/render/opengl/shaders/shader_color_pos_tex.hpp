@@ -31,11 +31,10 @@ class shader_color_pos_tex :
 	public ruis::render::coloring_texturing_shader, //
 	public shader_base
 {
-	GLint texture_uniform;
 	GLint color_uniform;
 
 public:
-	shader_color_pos_tex();
+	shader_color_pos_tex(utki::shared_ref<opengl::context> context);
 
 	shader_color_pos_tex(const shader_color_pos_tex&) = delete;
 	shader_color_pos_tex& operator=(const shader_color_pos_tex&) = delete;
@@ -25,20 +25,21 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-shader_color_pos_tex_alpha::shader_color_pos_tex_alpha() :
+shader_color_pos_tex_alpha::shader_color_pos_tex_alpha(utki::shared_ref<opengl::context> context) :
 	shader_base(
+		std::move(context),
 		R"qwertyuiop(
 			attribute vec4 a0;
 
 			attribute vec2 a1;
 
-			uniform mat4 matrix;
+			uniform float texture0_top_down;
 
 			varying vec2 tc0;
 
 			void main(void){
 				gl_Position = matrix * a0;
-				tc0 = vec2(a1.x, 1.0 - a1.y);
+				tc0 = vec2(a1.x, mix(1.0 - a1.y, a1.y, texture0_top_down));
 			}
 		)qwertyuiop",
 		R"qwertyuiop(		
@@ -58,7 +59,6 @@ shader_color_pos_tex_alpha::shader_color_pos_tex_alpha() :
 			}
 		)qwertyuiop"
 	),
-	texture_uniform(this->get_uniform("texture0")),
 	color_uniform(this->get_uniform("uniform_color"))
 {}
 
@@ -69,15 +69,12 @@ void shader_color_pos_tex_alpha::render(
 	const ruis::render::texture_2d& tex
 ) const
 {
-	constexpr auto texture_unit_number = 0;
-
 	ASSERT(dynamic_cast<const texture_2d*>(&tex))
+	draw_parameters params;
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
-	static_cast<const texture_2d&>(tex).bind(texture_unit_number);
-	this->bind();
-
-	this->set_uniform_sampler(this->texture_uniform, texture_unit_number);
-	this->set_uniform4f(this->color_uniform, color.x(), color.y(), color.z(), color.w());
+	params.texture = &static_cast<const texture_2d&>(tex);
+	params.color_uniform = this->color_uniform;
+	params.color = color;
 
-	this->shader_base::render(m, va);
+	this->shader_base::render(m, va, params);
 }
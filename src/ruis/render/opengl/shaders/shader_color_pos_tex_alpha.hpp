@@ -31,11 +31,10 @@ class shader_color_pos_tex_alpha :
 	public ruis::render::coloring_texturing_shader, //
 	public shader_base
 {
-	GLint texture_uniform;
 	GLint color_uniform;
 
 public:
-	shader_color_pos_tex_alpha();
+	shader_color_pos_tex_alpha(utki::shared_ref<opengl::context> context);
 
 	shader_color_pos_tex_alpha(const shader_color_pos_tex_alpha&) = delete;
 	shader_color_pos_tex_alpha& operator=(const shader_color_pos_tex_alpha&) = delete;
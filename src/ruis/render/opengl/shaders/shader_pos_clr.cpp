@@ -23,11 +23,10 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-shader_pos_clr::shader_pos_clr() :
+shader_pos_clr::shader_pos_clr(utki::shared_ref<opengl::context> context) :
 	shader_base(
+		std::move(context),
 		R"qwertyuiop(
-			uniform mat4 matrix;
-
 			attribute vec4 a0;
 			attribute vec4 a1;
 
@@ -50,7 +49,5 @@ shader_pos_clr::shader_pos_clr() :
 
 void shader_pos_clr::render(const r4::matrix4<float>& m, const ruis::render::vertex_array& va) const
 {
-	this->bind();
-
-	this->shader_base::render(m, va);
+	this->shader_base::render(m, va, draw_parameters());
 }
@@ -25,20 +25,21 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-shader_pos_tex::shader_pos_tex() :
+shader_pos_tex::shader_pos_tex(utki::shared_ref<opengl::context> context) :
 	shader_base(
+		std::move(context),
 		R"qwertyuiop(
 			attribute vec4 a0; // position
 
 			attribute vec2 a1; // texture coordinates
 
-			uniform mat4 matrix;
+			uniform float texture0_top_down;
 
 			varying vec2 tc0;
 
 			void main(void){
 				gl_Position = matrix * a0;
-				tc0 = vec2(a1.x, 1.0 - a1.y);
+				tc0 = vec2(a1.x, mix(1.0 - a1.y, a1.y, texture0_top_down));
 			}
 		)qwertyuiop",
 		R"qwertyuiop(
@@ -50,8 +51,7 @@ shader_pos_tex::shader_pos_tex() :
 				gl_FragColor = texture2D(texture0, tc0);
 			}
 		)qwertyuiop"
-	),
-	texture_uniform(this->get_uniform("texture0"))
+	)
 {}
 
 void shader_pos_tex::render(
@@ -60,14 +60,10 @@ void shader_pos_tex::render(
 	const ruis::render::texture_2d& tex
 ) const
 {
-	constexpr auto texture_unit_number = 0;
-
 	ASSERT(dynamic_cast<const texture_2d*>(&tex))
+	draw_parameters params;
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
-	static_cast<const texture_2d&>(tex).bind(texture_unit_number);
-	this->bind();
-
-	this->set_uniform_sampler(this->texture_uniform, texture_unit_number);
+	params.texture = &static_cast<const texture_2d&>(tex);
 
-	this->shader_base::render(m, va);
+	this->shader_base::render(m, va, params);
 }
@@ -31,10 +31,8 @@ class shader_pos_tex :
 	public ruis::render::texturing_shader, //
 	public shader_base
 {
-	GLint texture_uniform;
-
 public:
-	shader_pos_tex();
+	shader_pos_tex(utki::shared_ref<opengl::context> context);
 
 	shader_pos_tex(const shader_pos_tex&) = delete;
 	shader_pos_tex& operator=(const shader_pos_tex&) = delete;
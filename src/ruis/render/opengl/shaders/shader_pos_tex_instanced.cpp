@@ -0,0 +1,126 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "shader_pos_tex_instanced.hpp"
+
+#include "../texture_2d.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+constexpr GLuint first_instance_attribute = 2;
+constexpr GLuint num_instance_attributes = 4;
+} // namespace
+
+static_assert(
+	sizeof(r4::matrix4<float>) == num_instance_attributes * sizeof(r4::vector4<float>),
+	"matrix must be an array of vec4 rows"
+);
+
+shader_pos_tex_instanced::shader_pos_tex_instanced(utki::shared_ref<opengl::context> context) :
+	shader_base(
+		std::move(context),
+		R"qwertyuiop(
+			attribute vec4 a0; // position
+
+			attribute vec2 a1; // texture coordinates
+
+			// Per-instance matrix. Takes attribute locations 2-5.
+			// The matrix rows are passed as the mat4 columns, i.e. the matrix is transposed.
+			attribute mat4 a2;
+
+			uniform float texture0_top_down;
+
+			varying vec2 tc0;
+
+			void main(void){
+				// multiply by transposed matrix from the left
+				gl_Position = matrix * (a0 * a2);
+				tc0 = vec2(a1.x, mix(1.0 - a1.y, a1.y, texture0_top_down));
+			}
+		)qwertyuiop",
+		R"qwertyuiop(
+			uniform sampler2D texture0;
+
+			varying vec2 tc0;
+
+			void main(void){
+				gl_FragColor = texture2D(texture0, tc0);
+			}
+		)qwertyuiop"
+	)
+{}
+
+void shader_pos_tex_instanced::render(
+	const r4::matrix4<float>& m,
+	const ruis::render::vertex_array& va,
+	const ruis::render::texture_2d& tex,
+	utki::span<const r4::matrix4<float>> instance_matrices
+) const
+{
+	ASSERT(dynamic_cast<const texture_2d*>(&tex))
+	draw_parameters params;
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	params.texture = &static_cast<const texture_2d&>(tex);
+
+	this->render_instanced(
+		m,
+		va,
+		params,
+		utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<const r4::vector4<float>*>(instance_matrices.data()),
+			instance_matrices.size() * num_instance_attributes
+		),
+		first_instance_attribute,
+		num_instance_attributes
+	);
+}
+
+void shader_pos_tex_instanced::render(
+	const r4::matrix4<float>& m,
+	const geometry_pool& pool,
+	const ruis::render::texture_2d& tex,
+	utki::span<const geometry_pool::range> ranges,
+	utki::span<const r4::matrix4<float>> instance_matrices
+) const
+{
+	ASSERT(ranges.size() == instance_matrices.size())
+
+	ASSERT(dynamic_cast<const texture_2d*>(&tex))
+	draw_parameters params;
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	params.texture = &static_cast<const texture_2d&>(tex);
+
+	this->render_multi(
+		m,
+		params,
+		pool,
+		ranges,
+		utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<const r4::vector4<float>*>(instance_matrices.data()),
+			instance_matrices.size() * num_instance_attributes
+		),
+		first_instance_attribute,
+		num_instance_attributes
+	);
+}
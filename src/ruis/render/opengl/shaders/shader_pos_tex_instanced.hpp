@@ -0,0 +1,82 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <ruis/render/texture_2d.hpp>
+#include <ruis/render/vertex_array.hpp>
+
+#include "../shader_base.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Instanced variant of shader_pos_tex.
+ * Draws multiple instances of a textured vertex array with per-instance transformation matrix.
+ */
+class shader_pos_tex_instanced : public shader_base
+{
+public:
+	shader_pos_tex_instanced(utki::shared_ref<opengl::context> context);
+
+	shader_pos_tex_instanced(const shader_pos_tex_instanced&) = delete;
+	shader_pos_tex_instanced& operator=(const shader_pos_tex_instanced&) = delete;
+
+	shader_pos_tex_instanced(shader_pos_tex_instanced&&) = delete;
+	shader_pos_tex_instanced& operator=(shader_pos_tex_instanced&&) = delete;
+
+	~shader_pos_tex_instanced() override = default;
+
+	/**
+	 * @brief Render instances of vertex array.
+	 * Each instance is rendered with m * instance_matrix transformation.
+	 * @param m - transformation matrix, common for all instances.
+	 * @param va - vertex array to render.
+	 * @param tex - texture, common for all instances.
+	 * @param instance_matrices - per-instance transformation matrices.
+	 */
+	void render(
+		const r4::matrix4<float>& m,
+		const ruis::render::vertex_array& va,
+		const ruis::render::texture_2d& tex,
+		utki::span<const r4::matrix4<float>> instance_matrices
+	) const;
+
+	/**
+	 * @brief Render geometry pool ranges.
+	 * Each range is rendered with m * instance_matrix transformation
+	 * of the corresponding instance matrix, see shader_base::render_multi().
+	 * @param m - transformation matrix, common for all ranges.
+	 * @param pool - geometry pool to render ranges from.
+	 * @param tex - texture, common for all ranges.
+	 * @param ranges - ranges to render.
+	 * @param instance_matrices - per-range transformation matrices, one for each range.
+	 */
+	void render(
+		const r4::matrix4<float>& m,
+		const geometry_pool& pool,
+		const ruis::render::texture_2d& tex,
+		utki::span<const geometry_pool::range> ranges,
+		utki::span<const r4::matrix4<float>> instance_matrices
+	) const;
+};
+
+} // namespace ruis::render::opengl
@@ -0,0 +1,285 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "stream_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+namespace {
+bool is_buffer_storage_supported()
+{
+	return GLEW_ARB_buffer_storage && GLEW_ARB_sync;
+}
+} // namespace
+
+stream_buffer::stream_buffer(GLenum target, size_t capacity) :
+	target(target),
+	capacity(capacity),
+	buffer([]() {
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		glGenBuffers(1, &ret);
+		assert_opengl_no_error();
+		return ret;
+	}())
+{
+	ASSERT(capacity != 0)
+
+	glBindBuffer(this->target, this->buffer);
+	assert_opengl_no_error();
+
+	if (is_buffer_storage_supported()) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(this->target, GLsizeiptr(this->capacity), nullptr, flags);
+		assert_opengl_no_error();
+
+		this->mapped = static_cast<uint8_t*>(glMapBufferRange(this->target, 0, GLsizeiptr(this->capacity), flags));
+		assert_opengl_no_error();
+
+		if (!this->mapped) {
+			glDeleteBuffers(1, &this->buffer);
+			throw std::runtime_error("stream_buffer: glMapBufferRange() failed");
+		}
+	} else {
+		glBufferData(this->target, GLsizeiptr(this->capacity), nullptr, GL_STREAM_DRAW);
+		assert_opengl_no_error();
+	}
+}
+
+stream_buffer::~stream_buffer()
+{
+	for (const auto& f : this->fences) {
+		glDeleteSync(f.fence);
+	}
+
+	// deleting the buffer also unmaps it
+	glDeleteBuffers(1, &this->buffer);
+}
+
+void stream_buffer::insert_fence()
+{
+	this->fences.push_back({
+		.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+		.end = this->write_pos //
+	});
+	assert_opengl_no_error();
+}
+
+bool stream_buffer::release(bool wait)
+{
+	bool released = false;
+
+	while (!this->fences.empty()) {
+		const auto& f = this->fences.front();
+
+		// wait only until the first fence is released
+		bool block = wait && !released;
+
+		GLenum res = glClientWaitSync(
+			f.fence,
+			block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+			block ? std::numeric_limits<GLuint64>::max() : 0
+		);
+
+		if (res == GL_WAIT_FAILED) {
+			throw std::runtime_error("stream_buffer: glClientWaitSync() failed");
+		}
+
+		if (res == GL_TIMEOUT_EXPIRED) {
+			if (block) {
+				continue;
+			}
+			break;
+		}
+
+		this->free_pos = f.end;
+		glDeleteSync(f.fence);
+		this->fences.pop_front();
+		released = true;
+	}
+
+	return released;
+}
+
+void stream_buffer::wait_free(uint64_t end)
+{
+	// The bytes before write_pos are the only ones possibly used by GPU,
+	// so the space is free when everything before the end position in the previous lap
+	// or everything written at all is released.
+	auto is_free = [&]() {
+		return end - this->free_pos <= this->capacity || this->free_pos == this->write_pos;
+	};
+
+	if (is_free()) {
+		return;
+	}
+
+	this->release(false);
+
+	if (is_free()) {
+		return;
+	}
+
+	++this->stats.num_stalls;
+
+	if (this->fences.empty() || this->fences.back().end != this->write_pos) {
+		// all the draws using the written data have been issued, so it can be guarded by a fence
+		this->insert_fence();
+	}
+
+	do {
+		this->release(true);
+	} while (!is_free());
+}
+
+void stream_buffer::orphan()
+{
+	glBindBuffer(this->target, this->buffer);
+	assert_opengl_no_error();
+
+	glBufferData(this->target, GLsizeiptr(this->capacity), nullptr, GL_STREAM_DRAW);
+	assert_opengl_no_error();
+}
+
+void stream_buffer::write_unmapped(size_t offset, utki::span<const uint8_t> data)
+{
+	glBindBuffer(this->target, this->buffer);
+	assert_opengl_no_error();
+
+	if (GLEW_ARB_map_buffer_range) {
+		// The written range is not used by any pending draws, so no synchronization is needed.
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+
+		void* ptr = glMapBufferRange(this->target, GLintptr(offset), GLsizeiptr(data.size()), access);
+		assert_opengl_no_error();
+
+		if (ptr) {
+			std::memcpy(ptr, data.data(), data.size());
+			if (glUnmapBuffer(this->target) == GL_TRUE) {
+				return;
+			}
+			// The buffer contents became corrupted while mapped, this can happen, e.g. on screen mode change.
+			// Fall back to glBufferSubData().
+		}
+	}
+
+	glBufferSubData(this->target, GLintptr(offset), GLsizeiptr(data.size()), data.data());
+	assert_opengl_no_error();
+}
+
+void stream_buffer::reserve(size_t size)
+{
+	if (size > this->capacity) {
+		throw std::length_error("stream_buffer::reserve(): size is bigger than the buffer capacity");
+	}
+
+	auto cur_offset = size_t(this->write_pos % this->capacity);
+
+	uint64_t start = this->write_pos;
+	if (cur_offset + size > this->capacity) {
+		// wrap around to the beginning of the buffer
+		start += this->capacity - cur_offset;
+	}
+
+	if (this->mapped) {
+		// All the draws using the data written so far have been issued, so it can be guarded by a fence.
+		// Fence every quarter of the buffer, so that the space is reused in parts
+		// without waiting for the whole buffer to be released.
+		uint64_t fenced_pos = this->fences.empty() ? this->free_pos : this->fences.back().end;
+		if (this->write_pos - fenced_pos >= this->capacity / 4) {
+			this->insert_fence();
+		}
+
+		this->wait_free(start + size);
+	} else if (start % this->capacity == 0 && start != this->free_pos) {
+		// Instead of waiting for GPU, orphan the buffer storage each time the ring buffer wraps around.
+		// In unmapped mode the free_pos is the position where the buffer storage was last orphaned.
+		this->orphan();
+		this->free_pos = start;
+		++this->stats.num_orphans;
+	}
+
+	this->write_pos = start;
+	this->reserved_end = start + size;
+}
+
+size_t stream_buffer::write(utki::span<const uint8_t> data, size_t alignment)
+{
+	ASSERT(alignment != 0)
+
+	if (data.size() > this->capacity) {
+		throw std::length_error("stream_buffer::write(): data is bigger than the buffer capacity");
+	}
+
+	auto get_aligned_start = [&]() {
+		auto cur_offset = size_t(this->write_pos % this->capacity);
+		auto aligned_offset = (cur_offset + alignment - 1) / alignment * alignment;
+		return this->write_pos + (aligned_offset - cur_offset);
+	};
+
+	uint64_t start = get_aligned_start();
+
+	if (start + data.size() > this->reserved_end) {
+		// the data does not fit into the current reservation, so it is written for a separate draw call
+		this->reserve(std::min(data.size() + alignment - 1, this->capacity));
+		start = get_aligned_start();
+	}
+
+	uint64_t end = start + data.size();
+	ASSERT(end <= this->reserved_end)
+
+	auto offset = size_t(start % this->capacity);
+
+	if (this->mapped) {
+		std::memcpy(std::next(this->mapped, std::ptrdiff_t(offset)), data.data(), data.size());
+	} else {
+		this->write_unmapped(offset, data);
+	}
+
+	this->write_pos = end;
+	this->stats.num_bytes_written += data.size();
+
+	return offset;
+}
+
+void stream_buffer::end_frame()
+{
+	if (!this->mapped) {
+		return;
+	}
+
+	if (this->fences.empty() || this->fences.back().end != this->write_pos) {
+		this->insert_fence();
+	}
+
+	// free the space used by finished frames
+	this->release(false);
+}
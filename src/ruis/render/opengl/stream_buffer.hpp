@@ -0,0 +1,206 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include <GL/glew.h>
+#include <utki/span.hpp>
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Ring buffer for transient per-frame geometry.
+ * The data written to the ring buffer is supposed to be used by draws of the current frame only.
+ *
+ * All the data used by a single draw call has to be written within one reservation, see reserve().
+ * The ring buffer wraps around only when reserving, so the data written earlier for the same draw call
+ * is never overwritten or orphaned by the later writes.
+ *
+ * If OpenGL supports buffer storage, the buffer is persistently and coherently mapped,
+ * so writing data is a plain memory copy. The written parts of the buffer are guarded by fences,
+ * which are inserted when reserving, each time a quarter of the buffer has been written since the last fence,
+ * and at the end of frame, see end_frame(). Those parts are reused only after the fence is signaled,
+ * i.e. the GPU has finished the draws using them. With big enough buffer the CPU never waits for the fences.
+ *
+ * Otherwise, the data is written by mapping the buffer range with unsynchronized access,
+ * or with glBufferSubData() if buffer range mapping is not supported. When the ring buffer
+ * wraps around, the buffer storage is orphaned instead of waiting for fences.
+ */
+class stream_buffer
+{
+public:
+	const GLenum target;
+	const size_t capacity;
+
+	const GLuint buffer;
+
+	struct statistics {
+		/**
+		 * @brief Number of bytes written.
+		 */
+		size_t num_bytes_written = 0;
+
+		/**
+		 * @brief Number of times the CPU had to wait for GPU to free some space in the buffer.
+		 */
+		size_t num_stalls = 0;
+
+		/**
+		 * @brief Number of times the buffer storage was orphaned.
+		 */
+		size_t num_orphans = 0;
+	};
+
+private:
+	// pointer to persistently mapped buffer memory, nullptr if buffer storage is not supported
+	uint8_t* mapped = nullptr;
+
+	// Monotonic positions. All the bytes before free_pos are not used by GPU anymore.
+	// Bytes from free_pos to write_pos are possibly in use. Buffer offset is position % capacity.
+	uint64_t write_pos = 0;
+	uint64_t free_pos = 0;
+
+	// end position of the current reservation
+	uint64_t reserved_end = 0;
+
+	struct fenced_region {
+		GLsync fence;
+
+		// position of the end of the region
+		uint64_t end;
+	};
+
+	std::deque<fenced_region> fences;
+
+	statistics stats;
+
+	void insert_fence();
+
+	// returns true if some space was freed
+	bool release(bool wait);
+
+	// waits until the space before the end position is not used by GPU anymore
+	void wait_free(uint64_t end);
+
+	void orphan();
+
+	void write_unmapped(size_t offset, utki::span<const uint8_t> data);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param target - buffer binding target the buffer is used with, e.g. GL_ARRAY_BUFFER.
+	 * @param capacity - size of the buffer in bytes.
+	 */
+	stream_buffer(GLenum target, size_t capacity);
+
+	stream_buffer(const stream_buffer&) = delete;
+	stream_buffer& operator=(const stream_buffer&) = delete;
+
+	stream_buffer(stream_buffer&&) = delete;
+	stream_buffer& operator=(stream_buffer&&) = delete;
+
+	~stream_buffer();
+
+	/**
+	 * @brief Check if the buffer is persistently mapped.
+	 * @return true if OpenGL supports buffer storage and the buffer is persistently mapped.
+	 */
+	bool is_persistently_mapped() const noexcept
+	{
+		return this->mapped != nullptr;
+	}
+
+	/**
+	 * @brief Reserve contiguous space for the data of a draw call.
+	 * If the space does not fit till the end of the buffer, the ring buffer wraps around.
+	 * Has to be called before writing the data of a draw call which is written with several write() calls,
+	 * otherwise the ring buffer can wrap around in between the writes and the earlier data is lost.
+	 * So, must not be called in between the writes for the same draw call.
+	 * @param size - total size of the data to be written, including alignment padding, see get_reserve_size().
+	 * @throw std::length_error - if the size is bigger than the buffer capacity.
+	 */
+	void reserve(size_t size);
+
+	/**
+	 * @brief Get size to reserve for writing an array of values.
+	 * @param data - values to be written.
+	 * @return size of the values plus maximum alignment padding.
+	 */
+	template <typename value_type>
+	static size_t get_reserve_size(utki::span<value_type> data) noexcept
+	{
+		return data.size_bytes() + alignof(value_type) - 1;
+	}
+
+	/**
+	 * @brief Write data to the ring buffer.
+	 * The data is written to the current reservation. If it does not fit there, a new reservation is made.
+	 * In case the write is done with glBufferSubData(), the buffer is left bound to its target.
+	 * @param data - data to write.
+	 * @param alignment - alignment of the data offset within the buffer.
+	 * @return offset of the written data within the buffer.
+	 * @throw std::length_error - if the data is bigger than the buffer capacity.
+	 */
+	size_t write(utki::span<const uint8_t> data, size_t alignment);
+
+	/**
+	 * @brief Write array of values to the ring buffer.
+	 * The data offset is aligned to the value type alignment.
+	 * @param data - values to write.
+	 * @return offset of the written data within the buffer.
+	 * @throw std::length_error - if the data is bigger than the buffer capacity.
+	 */
+	template <typename value_type>
+	size_t write(utki::span<value_type> data)
+	{
+		return this->write(
+			utki::make_span(
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+				reinterpret_cast<const uint8_t*>(data.data()),
+				data.size_bytes()
+			),
+			alignof(value_type)
+		);
+	}
+
+	/**
+	 * @brief Mark the end of frame.
+	 * Inserts the fence guarding the data written during the frame and frees the space used by finished frames.
+	 * Calling it is optional, the fences are also inserted when reserving space.
+	 */
+	void end_frame();
+
+	const statistics& get_statistics() const noexcept
+	{
+		return this->stats;
+	}
+
+	void reset_statistics() noexcept
+	{
+		this->stats = statistics();
+	}
+};
+
+} // namespace ruis::render::opengl
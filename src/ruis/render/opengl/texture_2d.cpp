@@ -21,45 +21,133 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "texture_2d.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
+#include "memory_budget.hpp"
 #include "util.hpp"
 
 using namespace ruis::render::opengl;
 
+namespace {
+GLsizei to_num_levels(rasterimage::dimensioned::dimensions_type dims, texture_2d::mipmap mipmap)
+{
+	if (mipmap == texture_2d::mipmap::none) {
+		return 1;
+	}
+	// full mipmap chain down to 1x1
+	GLsizei num_levels = 0;
+	for (auto d = std::max(dims.x(), dims.y()); d != 0; d >>= 1) {
+		++num_levels;
+	}
+	return num_levels;
+}
+
+name_pool::texture_storage make_storage(
+	rasterimage::format type,
+	rasterimage::dimensioned::dimensions_type dims,
+	texture_2d::mipmap mipmap
+)
+{
+	return {
+		.internal_format = opengl_texture::to_internal_format(type),
+		.width = GLsizei(dims.x()),
+		.height = GLsizei(dims.y()),
+		.num_levels = to_num_levels(dims, mipmap),
+		.size = [&]() {
+			// sum up the sizes of all mipmap levels
+			size_t ret = 0;
+			for (auto d = dims; d.x() != 0 && d.y() != 0;) {
+				ret += size_t(d.x()) * size_t(d.y()) * rasterimage::to_num_channels(type);
+				if (mipmap == texture_2d::mipmap::none || (d.x() == 1 && d.y() == 1)) {
+					break;
+				}
+				d = {std::max(d.x() >> 1, 1u), std::max(d.y() >> 1, 1u)};
+			}
+			return ret;
+		}()
+	};
+}
+
+// checks the error of the storage allocation call
+bool is_out_of_memory()
+{
+	GLenum error = glGetError();
+	ASSERT(error == GL_NO_ERROR || error == GL_OUT_OF_MEMORY, [&](auto& o) {
+		o << "OpenGL error, code = " << int(error);
+	})
+	return error == GL_OUT_OF_MEMORY;
+}
+
+} // namespace
+
 texture_2d::texture_2d(
+	utki::shared_ref<opengl::context> context,
 	rasterimage::format type,
 	rasterimage::dimensioned::dimensions_type dims,
 	utki::span<const uint8_t> data,
-	ruis::render::factory::texture_2d_parameters params
+	ruis::render::factory::texture_2d_parameters params,
+	bool top_down
 ) :
-	ruis::render::texture_2d(dims)
+	opengl_texture(std::move(context), make_storage(type, dims, params.mipmap)),
+	ruis::render::texture_2d(dims),
+	pixel_format(type),
+	params(std::move(params))
 {
 	ASSERT(data.size() % rasterimage::to_num_channels(type) == 0)
 	ASSERT(data.size() % dims.x() == 0)
 	ASSERT(data.size() == 0 || data.size() / rasterimage::to_num_channels(type) / dims.x() == dims.y())
 
-	this->bind(0);
+	this->top_down = top_down;
 
-	GLint internal_format = this->set_swizzeling(type);
+	this->init(data.empty() ? nullptr : data.data());
+}
 
-	// we will be passing pixels to OpenGL which are 1-byte aligned.
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	assert_opengl_no_error();
+texture_2d::texture_2d(
+	utki::shared_ref<opengl::context> context,
+	rasterimage::image_variant&& image,
+	ruis::render::factory::texture_2d_parameters params
+) :
+	texture_2d(
+		std::move(context),
+		image.get_format(),
+		image.dims(),
+		utki::span<const uint8_t>(),
+		std::move(params),
+		true // image rows are top to bottom
+	)
+{
+	auto src = std::make_unique<const rasterimage::image_variant>(std::move(image));
 
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0, // 0th level, no mipmaps
-		internal_format, // internal format
-		GLsizei(dims.x()),
-		GLsizei(dims.y()),
-		0, // border, should be 0!
-		internal_format, // format of the texel data
-		GL_UNSIGNED_BYTE, // data type of the texel data
-		data.size() == 0 ? nullptr : data.data() // texel data
-	);
-	assert_opengl_no_error();
+	this->write_pixels(get_texel_data(*src).data());
 
-	if (!data.empty() && params.mipmap != texture_2d::mipmap::none) {
-		glGenerateMipmap(GL_TEXTURE_2D);
+	this->source = std::move(src);
+
+	this->context.get().get_memory_budget().add(*this);
+}
+
+texture_2d::~texture_2d()
+{
+	if (this->source) {
+		this->context.get().get_memory_budget().remove(*this);
+	}
+}
+
+void texture_2d::init(const GLvoid* pixels)
+{
+	if (!this->context.get().is_direct_state_access_enabled()) {
+		this->bind(0);
+	}
+
+	this->set_swizzeling(this->pixel_format);
+
+	// a recycled texture already has the storage of the same size and format
+	if (!this->recycled) {
+		this->allocate_storage();
+	}
+
+	if (pixels) {
+		this->write_pixels(pixels);
 	}
 
 	auto to_gl_filter = [](texture_2d::filter f) {
@@ -72,14 +160,14 @@ texture_2d::texture_2d(
 		return GL_NEAREST;
 	};
 
-	GLint mag_filter = to_gl_filter(params.mag_filter);
+	GLint mag_filter = to_gl_filter(this->params.mag_filter);
 
 	GLint min_filter = [&]() {
-		switch (params.mipmap) {
+		switch (this->params.mipmap) {
 			case texture_2d::mipmap::none:
-				return to_gl_filter(params.min_filter);
+				return to_gl_filter(this->params.min_filter);
 			case texture_2d::mipmap::nearest:
-				switch (params.min_filter) {
+				switch (this->params.min_filter) {
 					case texture_2d::filter::nearest:
 						return GL_NEAREST_MIPMAP_NEAREST;
 					case texture_2d::filter::linear:
@@ -87,7 +175,7 @@ texture_2d::texture_2d(
 				}
 				break;
 			case texture_2d::mipmap::linear:
-				switch (params.min_filter) {
+				switch (this->params.min_filter) {
 					case texture_2d::filter::nearest:
 						return GL_NEAREST_MIPMAP_LINEAR;
 					case texture_2d::filter::linear:
@@ -99,13 +187,235 @@ texture_2d::texture_2d(
 	}();
 
 	// It is necessary to set filter parameters for every texture. Otherwise it may not work.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+	this->set_parameter(GL_TEXTURE_MIN_FILTER, min_filter);
+	this->set_parameter(GL_TEXTURE_MAG_FILTER, mag_filter);
+
+	this->set_parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	this->set_parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void texture_2d::allocate_storage()
+{
+	if (this->try_allocate_storage()) {
+		return;
+	}
+
+	// OpenGL is out of memory, release the storage of the textures which are not in use and retry
+	this->context.get().flush_batch();
+	this->context.get().get_memory_budget().evict_unused();
+
+	if (!this->try_allocate_storage()) {
+		throw std::runtime_error("texture_2d: out of GPU memory");
+	}
+}
+
+bool texture_2d::try_allocate_storage()
+{
+	auto num_levels = to_num_levels(this->dims, this->params.mipmap);
+
+	if (this->context.get().is_immutable_texture_storage_enabled()) {
+		// immutable storage cannot have zero dimensions
+		if (this->dims.x() == 0 || this->dims.y() == 0) {
+			return true;
+		}
+
+		if (this->context.get().is_direct_state_access_enabled()) {
+			glTextureStorage2D(
+				this->tex,
+				num_levels,
+				to_sized_internal_format(this->pixel_format),
+				GLsizei(this->dims.x()),
+				GLsizei(this->dims.y())
+			);
+		} else {
+			this->bind(0);
+			glTexStorage2D(
+				GL_TEXTURE_2D,
+				num_levels,
+				to_sized_internal_format(this->pixel_format),
+				GLsizei(this->dims.x()),
+				GLsizei(this->dims.y())
+			);
+		}
+		return !is_out_of_memory();
+	}
+
+	this->bind(0);
+
+	GLint internal_format = to_internal_format(this->pixel_format);
+
+	glTexImage2D(
+		GL_TEXTURE_2D,
+		0, // 0th level, mipmaps are generated
+		internal_format, // internal format
+		GLsizei(this->dims.x()),
+		GLsizei(this->dims.y()),
+		0, // border, should be 0!
+		internal_format, // format of the texel data
+		GL_UNSIGNED_BYTE, // data type of the texel data
+		nullptr // no texel data
+	);
+	if (is_out_of_memory()) {
+		return false;
+	}
+
+	// Limit the mipmap levels to those which are going to be generated,
+	// otherwise the texture without mipmaps is checked for completeness of the missing levels.
+	this->set_parameter(GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+
+	return true;
+}
+
+size_t texture_2d::evict()
+{
+	ASSERT(this->source)
+	ASSERT(this->tex != 0)
+
+	this->context.get().forget_texture(this->tex);
+	glDeleteTextures(1, &this->tex);
 	assert_opengl_no_error();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+	this->tex = 0;
+
+	// the texture will get a new storage when restored
+	this->recycled = false;
+
+	return this->set_memory_size(0);
+}
+
+void texture_2d::restore()
+{
+	ASSERT(this->source)
+	ASSERT(this->tex == 0)
+
+	this->set_memory_size(make_storage(this->pixel_format, this->dims, this->params.mipmap).size);
+
+	this->tex = this->context.get().get_name_pool().gen_texture();
+
+	this->init(get_texel_data(*this->source).data());
+}
+
+void texture_2d::bind(unsigned unit_num) const
+{
+	if (this->source) {
+		// restores the texture if it was evicted
+		this->context.get().get_memory_budget().touch(*this);
+	}
+
+	this->opengl_texture::bind(unit_num);
+}
+
+void texture_2d::write_pixels(const GLvoid* pixels, size_t row_length)
+{
+	this->write_rectangle({{0, 0}, this->dims}, pixels, row_length);
+	this->generate_mipmaps();
+}
+
+void texture_2d::update(
+	const r4::rectangle<uint32_t>& rect,
+	utki::span<const uint8_t> data,
+	size_t row_stride,
+	bool regenerate_mipmaps
+)
+{
+	if (this->source) {
+		throw std::logic_error("texture_2d::update(): evictable texture cannot be updated");
+	}
+
+	if (rect.p.x() > this->dims.x() || rect.d.x() > this->dims.x() - rect.p.x() || //
+		rect.p.y() > this->dims.y() || rect.d.y() > this->dims.y() - rect.p.y())
+	{
+		throw std::out_of_range("texture_2d::update(): region does not fit into the texture");
+	}
+
+	auto num_channels = rasterimage::to_num_channels(this->pixel_format);
+	size_t row_size = size_t(rect.d.x()) * num_channels;
+
+	if (row_stride == 0) {
+		row_stride = row_size;
+	} else if (row_stride < row_size || row_stride % num_channels != 0) {
+		throw std::invalid_argument("texture_2d::update(): invalid row stride");
+	}
+
+	if (rect.d.x() == 0 || rect.d.y() == 0) {
+		return;
+	}
+
+	// the last row does not need to be followed by the row padding
+	if (data.size() < (size_t(rect.d.y()) - 1) * row_stride + row_size) {
+		throw std::invalid_argument("texture_2d::update(): texel data is too small");
+	}
+
+	// recorded draws use the current contents of the texture
+	this->context.get().flush();
+
+	this->write_rectangle(rect, data.data(), row_stride / num_channels);
+
+	if (regenerate_mipmaps) {
+		this->generate_mipmaps();
+	}
+}
+
+void texture_2d::generate_mipmaps()
+{
+	if (this->params.mipmap == texture_2d::mipmap::none) {
+		return;
+	}
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		glGenerateTextureMipmap(this->tex);
+	} else {
+		this->bind(0);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
 	assert_opengl_no_error();
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+void texture_2d::write_rectangle(const r4::rectangle<uint32_t>& rect, const GLvoid* pixels, size_t row_length)
+{
+	// we will be passing pixels to OpenGL which are 1-byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	assert_opengl_no_error();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	bool set_row_length = row_length != 0 && row_length != rect.d.x();
+	if (set_row_length) {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(row_length));
+		assert_opengl_no_error();
+	}
+
+	GLint format = to_internal_format(this->pixel_format);
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		glTextureSubImage2D(
+			this->tex,
+			0, // 0th level
+			GLint(rect.p.x()),
+			GLint(rect.p.y()),
+			GLsizei(rect.d.x()),
+			GLsizei(rect.d.y()),
+			format, // format of the texel data
+			GL_UNSIGNED_BYTE, // data type of the texel data
+			pixels // texel data
+		);
+	} else {
+		this->bind(0);
+
+		glTexSubImage2D(
+			GL_TEXTURE_2D,
+			0, // 0th level
+			GLint(rect.p.x()),
+			GLint(rect.p.y()),
+			GLsizei(rect.d.x()),
+			GLsizei(rect.d.y()),
+			format, // format of the texel data
+			GL_UNSIGNED_BYTE, // data type of the texel data
+			pixels // texel data
+		);
+	}
 	assert_opengl_no_error();
+
+	if (set_row_length) {
+		// other uploads assume tightly packed rows
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		assert_opengl_no_error();
+	}
 }
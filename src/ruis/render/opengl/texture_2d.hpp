@@ -21,6 +21,11 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <cstdint>
+#include <list>
+#include <memory>
+
+#include <r4/rectangle.hpp>
 #include <ruis/render/factory.hpp>
 #include <ruis/render/texture_2d.hpp>
 
@@ -32,11 +37,63 @@ class texture_2d :
 	public opengl_texture, //
 	public ruis::render::texture_2d
 {
+	friend class texture_upload_queue;
+	friend class memory_budget;
+
+	const rasterimage::format pixel_format;
+	const ruis::render::factory::texture_2d_parameters params;
+
+	// false while the texture data is being uploaded asynchronously
+	bool ready = true;
+
+	// image to restore the texel data of evicted texture from, nullptr if the texture is not evictable
+	std::unique_ptr<const rasterimage::image_variant> source;
+
+	// eviction state, managed by the memory budget, see memory_budget
+	bool evicted = false;
+	uint64_t last_used_frame = 0;
+	std::list<texture_2d*>::iterator lru_position;
+
+	// sets up the texture parameters, allocates the storage and writes the texel data if given
+	void init(const GLvoid* pixels);
+
+	// allocates the texture storage without texel data
+	void allocate_storage();
+
+	// returns false in case OpenGL is out of memory
+	bool try_allocate_storage();
+
+	// releases the texture storage, returns the size of the released storage in bytes
+	size_t evict();
+
+	// re-creates the texture storage and uploads the texel data from the source image
+	void restore();
+
+	// writes the texel data of the 0th level rectangle
+	void write_rectangle(const r4::rectangle<uint32_t>& rect, const GLvoid* pixels, size_t row_length);
+
 public:
 	texture_2d(
+		utki::shared_ref<opengl::context> context,
 		rasterimage::format type,
 		rasterimage::dimensioned::dimensions_type dims,
 		utki::span<const uint8_t> data,
+		ruis::render::factory::texture_2d_parameters params,
+		bool top_down = false
+	);
+
+	/**
+	 * @brief Constructor of evictable texture.
+	 * The texture keeps the image, so that in case the texture storage is evicted, see memory_budget,
+	 * it can be restored on the next bind. The image rows are uploaded top to bottom.
+	 * @param context - OpenGL context.
+	 * @param image - image with 8 bits per channel.
+	 * @param params - texture parameters.
+	 * @throw std::invalid_argument - if the image is not 8 bits per channel.
+	 */
+	texture_2d(
+		utki::shared_ref<opengl::context> context,
+		rasterimage::image_variant&& image,
 		ruis::render::factory::texture_2d_parameters params
 	);
 
@@ -46,7 +103,76 @@ public:
 	texture_2d(texture_2d&&) = delete;
 	texture_2d& operator=(texture_2d&&) = delete;
 
-	~texture_2d() override = default;
+	~texture_2d() override;
+
+	/**
+	 * @brief Bind the texture to the texture unit.
+	 * Evictable texture is marked as used, and restored if it was evicted, see memory_budget.
+	 * @param unit_num - texture unit number.
+	 */
+	void bind(unsigned unit_num) const;
+
+	/**
+	 * @brief Check if the texture storage can be evicted.
+	 * @return true if the texture was created from an image it keeps.
+	 */
+	bool is_evictable() const noexcept
+	{
+		return this->source != nullptr;
+	}
+
+	/**
+	 * @brief Check if the texture contents are ready.
+	 * Textures created with factory::create_texture_2d_async() have undefined contents
+	 * until the asynchronous upload of their texel data is finished, see texture_upload_queue.
+	 * @return true if the texture has its texel data.
+	 */
+	bool is_ready() const noexcept
+	{
+		return this->ready;
+	}
+
+	/**
+	 * @brief Write the whole texture texel data.
+	 * Mipmaps are regenerated if the texture has mipmaps.
+	 * @param pixels - pointer to the texel data in the format of the texture. In case a pixel unpack buffer
+	 *        is bound, it is the offset of the texel data within the buffer.
+	 * @param row_length - number of pixels from the beginning of one row of the texel data to the beginning
+	 *        of the next row. Allows uploading a sub-rectangle of a bigger image without repacking it.
+	 *        0 means the rows are tightly packed.
+	 */
+	void write_pixels(const GLvoid* pixels, size_t row_length = 0);
+
+	/**
+	 * @brief Update rectangular region of the texture.
+	 * The region coordinates are in the texel data rows order, i.e. for top-down textures,
+	 * see opengl_texture::top_down, the region origin is at the top left corner of the texture.
+	 * Pending rendering is flushed before the update, so that the recorded draws
+	 * use the texture contents they were recorded with.
+	 * @param rect - region to update.
+	 * @param data - 8-bit per channel texel data in the format of the texture.
+	 * @param row_stride - number of bytes from the beginning of one row of the data to the beginning
+	 *        of the next row. Must be a multiple of the number of channels. 0 means the rows are tightly packed.
+	 * @param regenerate_mipmaps - whether to regenerate mipmaps of the texture if it has mipmaps.
+	 *        Mipmaps regeneration processes the whole texture, so in case several regions are updated
+	 *        in a row, it is better to regenerate mipmaps only once after the last update,
+	 *        see generate_mipmaps().
+	 * @throw std::out_of_range - if the region does not fit into the texture.
+	 * @throw std::invalid_argument - if the row stride is invalid or the data is too small.
+	 * @throw std::logic_error - if the texture is evictable, since its contents are restored from its image.
+	 */
+	void update(
+		const r4::rectangle<uint32_t>& rect,
+		utki::span<const uint8_t> data,
+		size_t row_stride = 0,
+		bool regenerate_mipmaps = true
+	);
+
+	/**
+	 * @brief Regenerate mipmaps from the 0th level.
+	 * Does nothing if the texture has no mipmaps.
+	 */
+	void generate_mipmaps();
 };
 
 } // namespace ruis::render::opengl
@@ -0,0 +1,352 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "texture_atlas.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+using namespace ruis::render::opengl;
+
+texture_atlas::skyline::skyline(r4::vector2<uint32_t> dims) :
+	dims(dims)
+{
+	this->reset();
+}
+
+void texture_atlas::skyline::reset()
+{
+	this->segments.clear();
+	this->segments.push_back({.x = 0, .y = 0, .width = this->dims.x()});
+	this->area = 0;
+}
+
+std::optional<r4::vector2<uint32_t>> texture_atlas::skyline::allocate(r4::vector2<uint32_t> dims)
+{
+	ASSERT(dims.x() != 0)
+
+	auto best_index = this->segments.size();
+	uint32_t best_y = 0;
+	auto best_top = std::numeric_limits<uint32_t>::max();
+	auto best_width = std::numeric_limits<uint32_t>::max();
+
+	// find the position which keeps the skyline lowest, prefer narrower segments in case of tie
+	for (size_t i = 0; i != this->segments.size(); ++i) {
+		const auto& s = this->segments[i];
+
+		if (dims.x() > this->dims.x() - s.x) {
+			// the rest of the segments are even further to the right
+			break;
+		}
+
+		// the rectangle lies on the highest of the segments it spans
+		uint32_t y = 0;
+		uint32_t remaining = dims.x();
+		for (size_t j = i;; ++j) {
+			ASSERT(j < this->segments.size())
+			const auto& sj = this->segments[j];
+			y = std::max(y, sj.y);
+			if (sj.width >= remaining) {
+				break;
+			}
+			remaining -= sj.width;
+		}
+
+		if (dims.y() > this->dims.y() - y) {
+			continue;
+		}
+
+		uint32_t top = y + dims.y();
+		if (top < best_top || (top == best_top && s.width < best_width)) {
+			best_index = i;
+			best_y = y;
+			best_top = top;
+			best_width = s.width;
+		}
+	}
+
+	if (best_index == this->segments.size()) {
+		return {};
+	}
+
+	r4::vector2<uint32_t> pos = {this->segments[best_index].x, best_y};
+	uint32_t end = pos.x() + dims.x();
+
+	// cut the spanned segments, the area between them and the rectangle bottom becomes unusable
+	for (auto i = std::next(this->segments.begin(), ptrdiff_t(best_index));
+		 i != this->segments.end() && i->x < end;)
+	{
+		uint32_t segment_end = i->x + i->width;
+		this->area += size_t(std::min(segment_end, end) - i->x) * size_t(best_top - i->y);
+
+		if (segment_end <= end) {
+			i = this->segments.erase(i);
+		} else {
+			i->width = segment_end - end;
+			i->x = end;
+			break;
+		}
+	}
+
+	this->segments.insert(
+		std::next(this->segments.begin(), ptrdiff_t(best_index)),
+		{.x = pos.x(), .y = best_top, .width = dims.x()}
+	);
+
+	// merge neighbouring segments of the same height
+	for (size_t i = 1; i < this->segments.size();) {
+		auto& prev = this->segments[i - 1];
+		if (prev.y == this->segments[i].y) {
+			prev.width += this->segments[i].width;
+			this->segments.erase(std::next(this->segments.begin(), ptrdiff_t(i)));
+		} else {
+			++i;
+		}
+	}
+
+	return pos;
+}
+
+texture_atlas::texture_atlas(
+	utki::shared_ref<opengl::context> context,
+	rasterimage::format type,
+	r4::vector2<uint32_t> page_dims,
+	ruis::render::factory::texture_2d_parameters params,
+	uint32_t padding
+) :
+	context(std::move(context)),
+	pixel_format(type),
+	page_dims(page_dims),
+	params(std::move(params)),
+	padding(padding)
+{
+	if (page_dims.x() == 0 || page_dims.y() == 0) {
+		throw std::invalid_argument("texture_atlas::texture_atlas(): zero page dimensions");
+	}
+
+	if (padding >= page_dims.x() / 2 || padding >= page_dims.y() / 2) {
+		throw std::invalid_argument("texture_atlas::texture_atlas(): padding is too big for the page dimensions");
+	}
+
+	// the padding does not prevent bleeding of the neighbouring images at the coarser mipmap levels
+	if (this->params.mipmap != texture_2d::mipmap::none) {
+		throw std::invalid_argument("texture_atlas::texture_atlas(): mipmapped pages are not supported");
+	}
+}
+
+std::shared_ptr<const texture_atlas::region> texture_atlas::allocate(r4::vector2<uint32_t> dims)
+{
+	auto padded_dims = this->add_padding(dims);
+
+	auto try_allocate = [this, &padded_dims]() -> std::pair<page*, std::optional<r4::vector2<uint32_t>>> {
+		for (auto& p : this->pages) {
+			if (auto pos = p.packer.allocate(padded_dims)) {
+				return {&p, pos};
+			}
+		}
+		return {nullptr, std::nullopt};
+	};
+
+	auto [p, pos] = try_allocate();
+
+	if (!p) {
+		// try to reclaim space of released regions before adding a new page
+		this->collect();
+
+		std::tie(p, pos) = try_allocate();
+
+		if (!p) {
+			p = &this->pages.emplace_back(page{
+				.texture = utki::make_shared<texture_2d>(
+					this->context,
+					this->pixel_format,
+					this->page_dims,
+					utki::span<const uint8_t>(),
+					this->params,
+					true // rows are top to bottom
+				),
+				.packer = skyline(this->page_dims),
+				.regions = {}
+			});
+
+			pos = p->packer.allocate(padded_dims);
+			ASSERT(pos)
+		}
+	}
+
+	ASSERT(p)
+	ASSERT(pos)
+
+	r4::rectangle<uint32_t> rect = {
+		{pos.value().x() + this->padding, pos.value().y() + this->padding},
+		dims
+	};
+
+	auto page_dims_f = this->page_dims.to<float>();
+
+	auto r = std::make_shared<const region>(region{
+		.texture = p->texture,
+		.rect = rect,
+		.uv = {
+			{float(rect.p.x()) / page_dims_f.x(), float(rect.p.y()) / page_dims_f.y()},
+			{float(rect.d.x()) / page_dims_f.x(), float(rect.d.y()) / page_dims_f.y()}
+		}
+	});
+
+	p->regions.push_back(r);
+
+	return r;
+}
+
+std::shared_ptr<const texture_atlas::region> texture_atlas::add(
+	r4::vector2<uint32_t> dims,
+	utki::span<const uint8_t> data,
+	size_t row_stride
+)
+{
+	if (dims.x() == 0 || dims.y() == 0) {
+		throw std::invalid_argument("texture_atlas::add(): empty image");
+	}
+
+	if (dims.x() > this->page_dims.x() - this->padding * 2 || dims.y() > this->page_dims.y() - this->padding * 2) {
+		throw std::invalid_argument("texture_atlas::add(): image does not fit into a page");
+	}
+
+	auto num_channels = rasterimage::to_num_channels(this->pixel_format);
+	size_t row_size = size_t(dims.x()) * num_channels;
+
+	if (row_stride == 0) {
+		row_stride = row_size;
+	} else if (row_stride < row_size || row_stride % num_channels != 0) {
+		throw std::invalid_argument("texture_atlas::add(): invalid row stride");
+	}
+
+	if (data.size() < (size_t(dims.y()) - 1) * row_stride + row_size) {
+		throw std::invalid_argument("texture_atlas::add(): texel data is too small");
+	}
+
+	auto r = this->allocate(dims);
+
+	if (this->padding == 0) {
+		r->texture.get().update(r->rect, data, row_stride);
+		return r;
+	}
+
+	// surround the image with its edge texels
+	auto padded_dims = this->add_padding(dims);
+	size_t padded_row_size = size_t(padded_dims.x()) * num_channels;
+
+	std::vector<uint8_t> padded(padded_row_size * padded_dims.y());
+
+	for (uint32_t y = 0; y != padded_dims.y(); ++y) {
+		auto src_y = std::clamp(y, this->padding, this->padding + dims.y() - 1) - this->padding;
+		auto src = data.subspan(src_y * row_stride, row_size);
+		auto dst = std::next(padded.begin(), ptrdiff_t(y * padded_row_size));
+
+		for (uint32_t x = 0; x != this->padding; ++x) {
+			dst = std::copy(src.begin(), std::next(src.begin(), num_channels), dst);
+		}
+
+		dst = std::copy(src.begin(), src.end(), dst);
+
+		for (uint32_t x = 0; x != this->padding; ++x) {
+			dst = std::copy(std::prev(src.end(), num_channels), src.end(), dst);
+		}
+	}
+
+	r->texture.get().update(
+		{
+			{r->rect.p.x() - this->padding, r->rect.p.y() - this->padding},
+			padded_dims
+		},
+		padded
+	);
+
+	return r;
+}
+
+std::shared_ptr<const texture_atlas::region> texture_atlas::add(const rasterimage::image_variant& image)
+{
+	if (image.get_format() != this->pixel_format) {
+		throw std::invalid_argument("texture_atlas::add(): image format does not match the atlas format");
+	}
+
+	return this->add(image.dims(), opengl_texture::get_texel_data(image));
+}
+
+void texture_atlas::collect()
+{
+	bool has_empty_page = false;
+
+	for (auto i = this->pages.begin(); i != this->pages.end();) {
+		auto& regions = i->regions;
+		regions.erase(
+			std::remove_if(
+				regions.begin(),
+				regions.end(),
+				[](const auto& r) {
+					return r.expired();
+				}
+			),
+			regions.end()
+		);
+
+		if (!regions.empty()) {
+			++i;
+			continue;
+		}
+
+		if (has_empty_page) {
+			i = this->pages.erase(i);
+			continue;
+		}
+
+		has_empty_page = true;
+		i->packer.reset();
+		++i;
+	}
+}
+
+texture_atlas::statistics texture_atlas::get_statistics() const noexcept
+{
+	statistics ret;
+
+	for (const auto& p : this->pages) {
+		++ret.num_pages;
+		ret.page_area += size_t(this->page_dims.x()) * size_t(this->page_dims.y());
+		ret.allocated_area += p.packer.get_area();
+
+		for (const auto& wr : p.regions) {
+			auto r = wr.lock();
+			if (!r) {
+				continue;
+			}
+			++ret.num_regions;
+			auto padded_dims = this->add_padding(r->rect.d);
+			ret.used_area += size_t(padded_dims.x()) * size_t(padded_dims.y());
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,238 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <r4/rectangle.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <ruis/render/factory.hpp>
+#include <utki/shared_ref.hpp>
+#include <utki/span.hpp>
+
+#include "context.hpp"
+#include "texture_2d.hpp"
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Texture atlas.
+ * Packs many small images, like icons, glyphs or nine-patch pieces, into a few big textures, called pages.
+ * Drawing images which reside on the same page does not require re-binding the texture,
+ * so such draws can be merged, see batcher.
+ *
+ * The images are packed using the skyline algorithm. Each added image is represented by a region,
+ * which holds the page texture and the image rectangle on the page. The region occupies its place on the page
+ * as long as there are references to it. Space of released regions is reclaimed when the whole page
+ * becomes unused, see collect(), because moving the live regions would invalidate their texture coordinates
+ * which are possibly already stored in vertex buffers.
+ *
+ * Each image is surrounded by padding filled with the image's edge texels, so that linear filtering
+ * near the image edges does not pick up texels of the neighbouring images.
+ * The pages cannot have mipmaps, because texels of the neighbouring images are mixed together
+ * at the coarser mipmap levels regardless of the padding.
+ *
+ * The pages are top-down textures, see opengl_texture::is_top_down(), so the region rectangles
+ * and texture coordinates are in image coordinates, i.e. with origin at the top left corner.
+ */
+class texture_atlas
+{
+public:
+	/**
+	 * @brief Atlas region.
+	 * Represents an image added to the atlas.
+	 */
+	struct region {
+		/**
+		 * @brief Page texture the image resides on.
+		 */
+		const utki::shared_ref<texture_2d> texture;
+
+		/**
+		 * @brief Image rectangle on the page in texels, without padding.
+		 */
+		const r4::rectangle<uint32_t> rect;
+
+		/**
+		 * @brief Image rectangle on the page in texture coordinates.
+		 */
+		const r4::rectangle<float> uv;
+	};
+
+	struct statistics {
+		/**
+		 * @brief Number of pages.
+		 */
+		size_t num_pages = 0;
+
+		/**
+		 * @brief Number of live regions.
+		 */
+		size_t num_regions = 0;
+
+		/**
+		 * @brief Total area of all pages in texels.
+		 */
+		size_t page_area = 0;
+
+		/**
+		 * @brief Area occupied by live regions in texels, including padding.
+		 */
+		size_t used_area = 0;
+
+		/**
+		 * @brief Area consumed by the packer in texels.
+		 * Includes areas of live and released regions, as well as areas which
+		 * are left unusable under the skyline.
+		 */
+		size_t allocated_area = 0;
+
+		/**
+		 * @brief Get ratio of the area occupied by live regions to the total area of the pages.
+		 * @return Occupancy from 0 to 1.
+		 */
+		float occupancy() const noexcept
+		{
+			if (this->page_area == 0) {
+				return 0;
+			}
+			return float(this->used_area) / float(this->page_area);
+		}
+	};
+
+private:
+	const utki::shared_ref<opengl::context> context;
+
+	const rasterimage::format pixel_format;
+	const r4::vector2<uint32_t> page_dims;
+	const ruis::render::factory::texture_2d_parameters params;
+	const uint32_t padding;
+
+	// skyline rectangle packer
+	class skyline
+	{
+		struct segment {
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+		};
+
+		r4::vector2<uint32_t> dims;
+
+		// segments sorted by x, covering the whole width
+		std::vector<segment> segments;
+
+		size_t area = 0;
+
+	public:
+		skyline(r4::vector2<uint32_t> dims);
+
+		// returns position of the allocated rectangle or nothing if it does not fit
+		std::optional<r4::vector2<uint32_t>> allocate(r4::vector2<uint32_t> dims);
+
+		void reset();
+
+		// returns area under the skyline
+		size_t get_area() const noexcept
+		{
+			return this->area;
+		}
+	};
+
+	struct page {
+		utki::shared_ref<texture_2d> texture;
+		skyline packer;
+		std::vector<std::weak_ptr<const region>> regions;
+	};
+
+	std::vector<page> pages;
+
+	r4::vector2<uint32_t> add_padding(r4::vector2<uint32_t> dims) const noexcept
+	{
+		return {dims.x() + this->padding * 2, dims.y() + this->padding * 2};
+	}
+
+	std::shared_ptr<const region> allocate(r4::vector2<uint32_t> dims);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param type - pixel format of the pages.
+	 * @param page_dims - dimensions of the pages.
+	 * @param params - texture parameters of the pages, mipmapping must be disabled.
+	 * @param padding - number of texels to surround each image with.
+	 * @throw std::invalid_argument - if the page dimensions are zero, the padding is too big or mipmapping is enabled.
+	 */
+	texture_atlas(
+		utki::shared_ref<opengl::context> context,
+		rasterimage::format type,
+		r4::vector2<uint32_t> page_dims,
+		ruis::render::factory::texture_2d_parameters params,
+		uint32_t padding = 1
+	);
+
+	texture_atlas(const texture_atlas&) = delete;
+	texture_atlas& operator=(const texture_atlas&) = delete;
+
+	texture_atlas(texture_atlas&&) = delete;
+	texture_atlas& operator=(texture_atlas&&) = delete;
+
+	~texture_atlas() = default;
+
+	/**
+	 * @brief Add image to the atlas.
+	 * @param dims - image dimensions.
+	 * @param data - 8-bit per channel texel data in the pixel format of the atlas, rows are top to bottom.
+	 * @param row_stride - number of bytes from the beginning of one row of the data to the beginning
+	 *        of the next row. 0 means the rows are tightly packed.
+	 * @return Region of the added image.
+	 * @throw std::invalid_argument - if the image with padding does not fit into a page,
+	 *        or the row stride is invalid, or the data is too small.
+	 */
+	std::shared_ptr<const region> add(
+		r4::vector2<uint32_t> dims,
+		utki::span<const uint8_t> data,
+		size_t row_stride = 0
+	);
+
+	/**
+	 * @brief Add image to the atlas.
+	 * @param image - image to add, must have the pixel format of the atlas and 8 bits per channel.
+	 * @return Region of the added image.
+	 * @throw std::invalid_argument - if the image format does not match or the image does not fit into a page.
+	 */
+	std::shared_ptr<const region> add(const rasterimage::image_variant& image);
+
+	/**
+	 * @brief Reclaim space of released regions.
+	 * Pages which have no live regions are made empty. All empty pages but one are destroyed.
+	 * Called automatically when a new image does not fit into any page.
+	 */
+	void collect();
+
+	statistics get_statistics() const noexcept;
+};
+
+} // namespace ruis::render::opengl
@@ -25,24 +25,76 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-texture_cube::texture_cube(const std::array<cube_face_image, num_cube_faces>& side_images)
+texture_cube::texture_cube(
+	utki::shared_ref<opengl::context> context, //
+	const std::array<cube_face_image, num_cube_faces>& side_images
+) :
+	opengl_texture(std::move(context), GL_TEXTURE_CUBE_MAP)
 {
+	this->set_memory_size([&]() {
+		size_t ret = 0;
+		for (const auto& s : side_images) {
+			ret += size_t(s.dims.x()) * size_t(s.dims.y()) * rasterimage::to_num_channels(s.type);
+		}
+		return ret;
+	}());
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		this->init_using_direct_state_access(side_images);
+		return;
+	}
+
 	this->bind(0);
 
+	bool immutable = this->context.get().is_immutable_texture_storage_enabled();
+
+	if (immutable) {
+		const auto& first = side_images.front();
+
+		// all faces of a cube map texture have the same size and format
+		if (first.dims.x() != 0 && first.dims.y() != 0) {
+			glTexStorage2D(
+				GL_TEXTURE_CUBE_MAP,
+				1, // no mipmaps
+				to_sized_internal_format(first.type),
+				GLsizei(first.dims.x()),
+				GLsizei(first.dims.y())
+			);
+			assert_opengl_no_error();
+		}
+	}
+
 	unsigned i = 0;
 	for (const auto& s : side_images) {
-		auto format = this->set_swizzeling(s.type);
-		glTexImage2D( //
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-			0, // 0th level, no mipmaps
-			format, // internal format
-			GLsizei(s.dims.x()),
-			GLsizei(s.dims.y()),
-			0, // border, should be 0
-			format, // format of the texel data
-			GL_UNSIGNED_BYTE,
-			s.data.data()
-		);
+		auto format = this->set_swizzeling(s.type, GL_TEXTURE_CUBE_MAP);
+		if (immutable) {
+			if (!s.data.empty()) {
+				glTexSubImage2D(
+					GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+					0, // 0th level
+					0, // x offset
+					0, // y offset
+					GLsizei(s.dims.x()),
+					GLsizei(s.dims.y()),
+					format, // format of the texel data
+					GL_UNSIGNED_BYTE,
+					s.data.data()
+				);
+				assert_opengl_no_error();
+			}
+		} else {
+			glTexImage2D( //
+				GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+				0, // 0th level, no mipmaps
+				format, // internal format
+				GLsizei(s.dims.x()),
+				GLsizei(s.dims.y()),
+				0, // border, should be 0
+				format, // format of the texel data
+				GL_UNSIGNED_BYTE,
+				s.data.data()
+			);
+		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -52,10 +104,57 @@ texture_cube::texture_cube(const std::array<cube_face_image, num_cube_faces>& si
 	}
 }
 
-void texture_cube::bind(unsigned unit_num) const
+void texture_cube::init_using_direct_state_access(const std::array<cube_face_image, num_cube_faces>& side_images)
 {
-	this->set_active_texture(unit_num);
+	ASSERT(this->context.get().is_direct_state_access_enabled())
+
+	const auto& first = side_images.front();
+
+	// all faces of a cube map texture have the same size and format
+	if (first.dims.x() != 0 && first.dims.y() != 0) {
+		glTextureStorage2D(
+			this->tex,
+			1, // no mipmaps
+			to_sized_internal_format(first.type),
+			GLsizei(first.dims.x()),
+			GLsizei(first.dims.y())
+		);
+		assert_opengl_no_error();
+	}
+
+	GLint face = 0;
+	for (const auto& s : side_images) {
+		auto format = this->set_swizzeling(s.type, GL_TEXTURE_CUBE_MAP);
+
+		if (!s.data.empty()) {
+			// faces of the cube map are layers of the texture in the order of
+			// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i targets
+			glTextureSubImage3D(
+				this->tex,
+				0, // 0th level
+				0, // x offset
+				0, // y offset
+				face, // z offset
+				GLsizei(s.dims.x()),
+				GLsizei(s.dims.y()),
+				1, // depth
+				format, // format of the texel data
+				GL_UNSIGNED_BYTE,
+				s.data.data()
+			);
+			assert_opengl_no_error();
+		}
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, this->tex);
-	assert_opengl_no_error();
+		++face;
+	}
+
+	this->set_parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	this->set_parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	this->set_parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	this->set_parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void texture_cube::bind(unsigned unit_num) const
+{
+	this->context.get().bind_texture(unit_num, GL_TEXTURE_CUBE_MAP, this->tex);
 }
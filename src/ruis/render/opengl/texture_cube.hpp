@@ -41,7 +41,10 @@ public:
 
 	constexpr static const auto num_cube_faces = 6;
 
-	texture_cube(const std::array<cube_face_image, num_cube_faces>& side_images);
+	texture_cube(
+		utki::shared_ref<opengl::context> context, //
+		const std::array<cube_face_image, num_cube_faces>& side_images
+	);
 
 	texture_cube(const texture_cube&) = delete;
 	texture_cube& operator=(const texture_cube&) = delete;
@@ -52,6 +55,10 @@ public:
 	~texture_cube() override = default;
 
 	void bind(unsigned unit_num) const;
+
+private:
+	// creates immutable texture storage and uploads the faces without binding the texture
+	void init_using_direct_state_access(const std::array<cube_face_image, num_cube_faces>& side_images);
 };
 
 } // namespace ruis::render::opengl
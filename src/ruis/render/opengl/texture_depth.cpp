@@ -25,30 +25,62 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 using namespace ruis::render::opengl;
 
-texture_depth::texture_depth(r4::vector2<uint32_t> dims) :
+texture_depth::texture_depth(
+	utki::shared_ref<opengl::context> context, //
+	r4::vector2<uint32_t> dims
+) :
+	opengl_texture(std::move(context)),
 	ruis::render::texture_depth(dims)
 {
-	this->bind(0);
-
-	glTexImage2D( //
-		GL_TEXTURE_2D,
-		0, // 0th level, no mipmaps
-		GL_DEPTH_COMPONENT, // internal format
-		GLsizei(dims.x()),
-		GLsizei(dims.y()),
-		0, // border, deprecated, should be 0
-		GL_DEPTH_COMPONENT, // format of the texel data
-		GL_FLOAT, // data type of the texel data
-		nullptr // texel data
-	);
-	assert_opengl_no_error();
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	assert_opengl_no_error();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	assert_opengl_no_error();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	assert_opengl_no_error();
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	assert_opengl_no_error();
+	// 24-bit depth component is stored in 4 bytes
+	constexpr auto depth_texel_size = 4;
+	this->set_memory_size(size_t(dims.x()) * size_t(dims.y()) * depth_texel_size);
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		// immutable storage cannot have zero dimensions
+		if (dims.x() != 0 && dims.y() != 0) {
+			glTextureStorage2D(
+				this->tex,
+				1, // no mipmaps
+				GL_DEPTH_COMPONENT24,
+				GLsizei(dims.x()),
+				GLsizei(dims.y())
+			);
+			assert_opengl_no_error();
+		}
+	} else if (this->context.get().is_immutable_texture_storage_enabled()) {
+		this->bind(0);
+
+		// immutable storage cannot have zero dimensions
+		if (dims.x() != 0 && dims.y() != 0) {
+			glTexStorage2D(
+				GL_TEXTURE_2D,
+				1, // no mipmaps
+				GL_DEPTH_COMPONENT24,
+				GLsizei(dims.x()),
+				GLsizei(dims.y())
+			);
+			assert_opengl_no_error();
+		}
+	} else {
+		this->bind(0);
+
+		glTexImage2D( //
+			GL_TEXTURE_2D,
+			0, // 0th level, no mipmaps
+			GL_DEPTH_COMPONENT, // internal format
+			GLsizei(dims.x()),
+			GLsizei(dims.y()),
+			0, // border, deprecated, should be 0
+			GL_DEPTH_COMPONENT, // format of the texel data
+			GL_FLOAT, // data type of the texel data
+			nullptr // texel data
+		);
+		assert_opengl_no_error();
+	}
+
+	this->set_parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	this->set_parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	this->set_parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	this->set_parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "texture_upload_queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "texture_2d.hpp"
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+texture_upload_queue::texture_upload_queue(name_pool& names, memory_budget& budget) :
+	names(names),
+	budget(budget),
+	use_pixel_buffers(GLEW_ARB_pixel_buffer_object && GLEW_ARB_sync)
+{}
+
+texture_upload_queue::~texture_upload_queue()
+{
+	for (const auto& u : this->submitted) {
+		glDeleteSync(u.fence);
+		glDeleteBuffers(1, &u.pbo);
+		this->budget.free(memory_budget::category::buffer, u.size);
+	}
+}
+
+void texture_upload_queue::push(const std::shared_ptr<texture_2d>& texture, rasterimage::image_variant image)
+{
+	ASSERT(texture)
+	texture->ready = false;
+	this->pending.push_back({.texture = texture, .image = std::move(image)});
+}
+
+void texture_upload_queue::process()
+{
+	this->retire_finished();
+
+	size_t num_bytes = 0;
+	while (!this->pending.empty() && num_bytes < max_bytes_per_frame) {
+		num_bytes += this->submit(this->pending.front());
+		this->pending.pop_front();
+	}
+
+	this->stats.num_bytes_uploaded += num_bytes;
+	this->stats.max_bytes_per_frame = std::max(this->stats.max_bytes_per_frame, num_bytes);
+}
+
+size_t texture_upload_queue::submit(pending_upload& upload)
+{
+	auto texture = upload.texture.lock();
+	if (!texture) {
+		// the texture was destroyed before its data was uploaded
+		return 0;
+	}
+
+	auto data = texture_2d::get_texel_data(upload.image);
+	if (data.empty()) {
+		texture->ready = true;
+		return 0;
+	}
+
+	++this->stats.num_uploads;
+
+	if (!this->use_pixel_buffers) {
+		texture->write_pixels(data.data());
+		texture->ready = true;
+		return data.size();
+	}
+
+	name_pool::buffer_storage storage = {
+		.target = GL_PIXEL_UNPACK_BUFFER,
+		.size = data.size(),
+		.usage = GL_STREAM_DRAW //
+	};
+
+	// recycled pixel buffer already has the storage of the required size
+	GLuint pbo = this->names.acquire_buffer(storage);
+	bool recycled = pbo != 0;
+	if (!recycled) {
+		pbo = this->names.gen_buffer();
+	}
+
+	this->budget.allocate(memory_budget::category::buffer, data.size());
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	assert_opengl_no_error();
+
+	if (!recycled) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(data.size()), nullptr, GL_STREAM_DRAW);
+		assert_opengl_no_error();
+	}
+
+	// copy the texel data to the pixel buffer, the copy does not wait for the driver
+	bool copied = false;
+	if (GLEW_ARB_map_buffer_range) {
+		void* p = glMapBufferRange(
+			GL_PIXEL_UNPACK_BUFFER,
+			0,
+			GLsizeiptr(data.size()),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+		);
+		assert_opengl_no_error();
+		if (p) {
+			std::memcpy(p, data.data(), data.size());
+			// unmapping fails in case the buffer contents got corrupted while mapped, then write it once again
+			copied = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+			assert_opengl_no_error();
+		}
+	}
+	if (!copied) {
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(data.size()), data.data());
+		assert_opengl_no_error();
+	}
+
+	// with pixel unpack buffer bound, the texel data pointer is the offset within the buffer
+	texture->write_pixels(nullptr);
+
+	// Client memory pointers passed to texture uploads are interpreted as offsets
+	// while a pixel unpack buffer is bound, so unbind it.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	assert_opengl_no_error();
+
+	this->submitted.push_back({
+		.texture = upload.texture,
+		.pbo = pbo,
+		.size = data.size(),
+		.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) //
+	});
+	assert_opengl_no_error();
+
+	return data.size();
+}
+
+void texture_upload_queue::retire_finished()
+{
+	// retires the upload if it is finished
+	auto retire = [this](const submitted_upload& u) {
+		GLenum res = glClientWaitSync(u.fence, 0, 0);
+
+		if (res == GL_WAIT_FAILED) {
+			throw std::runtime_error("texture_upload_queue: glClientWaitSync() failed");
+		}
+
+		if (res == GL_TIMEOUT_EXPIRED) {
+			return false;
+		}
+
+		glDeleteSync(u.fence);
+
+		// the upload is finished, so the pixel buffer can be reused
+		this->budget.free(memory_budget::category::buffer, u.size);
+		this->names.recycle_buffer(
+			u.pbo,
+			{
+				.target = GL_PIXEL_UNPACK_BUFFER,
+				.size = u.size,
+				.usage = GL_STREAM_DRAW //
+			}
+		);
+
+		if (auto texture = u.texture.lock()) {
+			texture->ready = true;
+		}
+
+		return true;
+	};
+
+	auto retired_begin = std::remove_if(this->submitted.begin(), this->submitted.end(), retire);
+
+	if (retired_begin != this->submitted.end()) {
+		this->submitted.erase(retired_begin, this->submitted.end());
+
+		// recycling may leave the pixel buffer bound, see name_pool::recycle_buffer()
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		assert_opengl_no_error();
+	}
+}
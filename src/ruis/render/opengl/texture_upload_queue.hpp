@@ -0,0 +1,163 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+#include <rasterimage/image_variant.hpp>
+
+#include "memory_budget.hpp"
+#include "name_pool.hpp"
+
+namespace ruis::render::opengl {
+
+class texture_2d;
+
+/**
+ * @brief Queue of asynchronous texture uploads.
+ * Uploading texel data of a texture from client memory is synchronous, the driver copies
+ * the data before the upload call returns. Uploading many big images at once, e.g. when
+ * loading a screen full of images, causes frame time spikes.
+ *
+ * The queue spreads the uploads across frames. Each frame, see process(), the texel data
+ * of several textures, up to max_bytes_per_frame in total, is copied to pixel buffer objects,
+ * and the texture uploads are done from those pixel buffer objects, which lets the driver
+ * transfer the data to the texture asynchronously. A texture is marked as ready,
+ * see texture_2d::is_ready(), when its upload is finished on the GPU side,
+ * which is tracked with fence sync objects.
+ *
+ * If pixel buffer objects are not supported by OpenGL, the uploads are done from client memory,
+ * still spread across frames.
+ */
+class texture_upload_queue
+{
+public:
+	/**
+	 * @brief Maximum number of bytes uploaded per frame.
+	 * At least one texture is uploaded per frame, even if it is bigger than that.
+	 */
+	constexpr static const size_t max_bytes_per_frame = size_t(8) * 1024 * 1024;
+
+	struct statistics {
+		/**
+		 * @brief Number of textures uploaded.
+		 */
+		size_t num_uploads = 0;
+
+		/**
+		 * @brief Number of texel data bytes uploaded.
+		 */
+		size_t num_bytes_uploaded = 0;
+
+		/**
+		 * @brief Maximum number of bytes uploaded during a single frame.
+		 */
+		size_t max_bytes_per_frame = 0;
+	};
+
+private:
+	name_pool& names;
+	memory_budget& budget;
+
+	const bool use_pixel_buffers;
+
+	struct pending_upload {
+		std::weak_ptr<texture_2d> texture;
+
+		// owns the texel data
+		rasterimage::image_variant image;
+	};
+
+	std::deque<pending_upload> pending;
+
+	struct submitted_upload {
+		std::weak_ptr<texture_2d> texture;
+		GLuint pbo;
+		size_t size;
+		GLsync fence;
+	};
+
+	std::vector<submitted_upload> submitted;
+
+	statistics stats;
+
+	// returns number of bytes uploaded
+	size_t submit(pending_upload& upload);
+
+	void retire_finished();
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param names - name pool to take pixel buffer objects from.
+	 * @param budget - memory budget to account pixel buffer objects in.
+	 */
+	texture_upload_queue(name_pool& names, memory_budget& budget);
+
+	texture_upload_queue(const texture_upload_queue&) = delete;
+	texture_upload_queue& operator=(const texture_upload_queue&) = delete;
+
+	texture_upload_queue(texture_upload_queue&&) = delete;
+	texture_upload_queue& operator=(texture_upload_queue&&) = delete;
+
+	~texture_upload_queue();
+
+	/**
+	 * @brief Queue texture upload.
+	 * The texture is marked as not ready until the upload is finished.
+	 * In case the texture is destroyed before its data is uploaded, the upload is dropped.
+	 * @param texture - texture to upload the data to.
+	 * @param image - texel data, must have the same format and dimensions as the texture.
+	 */
+	void push(const std::shared_ptr<texture_2d>& texture, rasterimage::image_variant image);
+
+	/**
+	 * @brief Process uploads.
+	 * Submits the queued uploads, within the per frame limit, and marks the textures
+	 * whose uploads are finished as ready. Called once per frame by the context.
+	 */
+	void process();
+
+	/**
+	 * @brief Check if there are no queued or unfinished uploads.
+	 * @return true if all uploads are finished.
+	 */
+	bool empty() const noexcept
+	{
+		return this->pending.empty() && this->submitted.empty();
+	}
+
+	const statistics& get_statistics() const noexcept
+	{
+		return this->stats;
+	}
+
+	void reset_statistics() noexcept
+	{
+		this->stats = statistics();
+	}
+};
+
+} // namespace ruis::render::opengl
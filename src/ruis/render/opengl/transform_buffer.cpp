@@ -0,0 +1,100 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "transform_buffer.hpp"
+
+#include <cstring>
+
+#include <utki/debug.hpp>
+
+#include "util.hpp"
+
+using namespace ruis::render::opengl;
+
+bool transform_buffer::is_supported() noexcept
+{
+	return GLEW_ARB_uniform_buffer_object;
+}
+
+transform_buffer::transform_buffer() :
+	ubo([]() {
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		glGenBuffers(1, &ret);
+		assert_opengl_no_error();
+		return ret;
+	}()),
+	slot_size([]() {
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		ASSERT(alignment > 0)
+		auto a = size_t(alignment);
+		return (sizeof(r4::matrix4<float>) + a - 1) / a * a;
+	}())
+{
+	static_assert(
+		sizeof(r4::matrix4<float>) == sizeof(float) * 4 * 4,
+		"matrix must have std140 layout of row-major mat4"
+	);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, this->ubo);
+	assert_opengl_no_error();
+	glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+	assert_opengl_no_error();
+}
+
+transform_buffer::~transform_buffer()
+{
+	glDeleteBuffers(1, &this->ubo);
+}
+
+bool transform_buffer::is_current(const r4::matrix4<float>& m) const noexcept
+{
+	// bitwise comparison, see shader_base::update_uniform_cache()
+	return this->valid && std::memcmp(this->matrix.data(), m.data(), sizeof(m)) == 0;
+}
+
+void transform_buffer::set(const r4::matrix4<float>& m)
+{
+	if (this->valid) {
+		this->offset += this->slot_size;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, this->ubo);
+	assert_opengl_no_error();
+
+	if (this->offset + this->slot_size > capacity) {
+		// The buffer is full, orphan its storage, so that the driver allocates
+		// a new one instead of waiting until the draws using the old one are finished.
+		glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+		assert_opengl_no_error();
+		this->offset = 0;
+	}
+
+	glBufferSubData(GL_UNIFORM_BUFFER, GLintptr(this->offset), sizeof(m), m.data());
+	assert_opengl_no_error();
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, this->ubo, GLintptr(this->offset), sizeof(m));
+	assert_opengl_no_error();
+
+	this->matrix = m;
+	this->valid = true;
+}
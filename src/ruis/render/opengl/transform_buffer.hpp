@@ -0,0 +1,118 @@
+/*
+ruis-render-opengl - OpenGL renderer
+
+Copyright (C) 2012-2024  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <r4/matrix.hpp>
+
+namespace ruis::render::opengl {
+
+/**
+ * @brief Ring-buffered uniform buffer for the transformation matrix.
+ * All shader programs declare the transformation matrix in the same std140 uniform block,
+ * which is bound to a fixed binding point. Each new matrix is written to the next slot of
+ * the uniform buffer and the slot is selected with glBindBufferRange(), so the matrix
+ * is shared by all the programs and is not re-uploaded on program switch.
+ * The matrix is declared row-major, so it is uploaded as is, without transposing.
+ */
+class transform_buffer
+{
+public:
+	/**
+	 * @brief Uniform block binding point of the transformation matrix block.
+	 */
+	constexpr static const GLuint binding_point = 0;
+
+	/**
+	 * @brief Size of the uniform buffer in bytes.
+	 */
+	constexpr static const size_t capacity = size_t(64) * 1024;
+
+	/**
+	 * @brief Name of the transformation matrix uniform block.
+	 */
+	constexpr static const char* const block_name = "transform_block";
+
+	/**
+	 * @brief GLSL declaration of the transformation matrix uniform block.
+	 */
+	constexpr static const char* const glsl_declaration = R"qwertyuiop(
+		#extension GL_ARB_uniform_buffer_object : require
+		layout(std140, row_major) uniform transform_block {
+			mat4 matrix;
+		};
+	)qwertyuiop";
+
+private:
+	const GLuint ubo;
+
+	// size of a slot, i.e. size of the matrix rounded up to uniform buffer offset alignment
+	const size_t slot_size;
+
+	// offset of the currently bound slot
+	size_t offset = 0;
+
+	bool valid = false;
+
+	r4::matrix4<float> matrix;
+
+public:
+	transform_buffer();
+
+	transform_buffer(const transform_buffer&) = delete;
+	transform_buffer& operator=(const transform_buffer&) = delete;
+
+	transform_buffer(transform_buffer&&) = delete;
+	transform_buffer& operator=(transform_buffer&&) = delete;
+
+	~transform_buffer();
+
+	/**
+	 * @brief Check if uniform buffers are supported by OpenGL.
+	 * @return true if uniform buffers are supported.
+	 */
+	static bool is_supported() noexcept;
+
+	/**
+	 * @brief Check if the matrix is currently set.
+	 * @param m - matrix to check.
+	 * @return true if the currently bound slot holds the matrix.
+	 */
+	bool is_current(const r4::matrix4<float>& m) const noexcept;
+
+	/**
+	 * @brief Write the matrix to the next slot and bind the slot.
+	 * @param m - matrix to set.
+	 */
+	void set(const r4::matrix4<float>& m);
+
+	/**
+	 * @brief Forget the currently bound slot.
+	 * Needs to be called in case the uniform buffer binding was changed by some foreign code.
+	 */
+	void invalidate() noexcept
+	{
+		this->valid = false;
+	}
+};
+
+} // namespace ruis::render::opengl
@@ -21,35 +21,99 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "vertex_array.hpp"
 
+#include <stdexcept>
+
+#include "deletion_queue.hpp"
 #include "index_buffer.hpp"
+#include "interleaved_vertex_buffer.hpp"
 #include "util.hpp"
 #include "vertex_buffer.hpp"
 
 using namespace ruis::render::opengl;
 
+namespace {
+GLsizei to_type_size(GLenum type)
+{
+	switch (type) {
+		default:
+			ASSERT(false)
+			[[fallthrough]];
+		case GL_FLOAT:
+			return sizeof(GLfloat);
+		case GL_HALF_FLOAT:
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+			return sizeof(GLshort);
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE:
+			return sizeof(GLbyte);
+	}
+}
+
+GLsizei get_num_indices(const ruis::render::index_buffer& indices)
+{
+	ASSERT(dynamic_cast<const index_buffer*>(&indices))
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+	return static_cast<const index_buffer&>(indices).elements_count;
+}
+} // namespace
+
 vertex_array::vertex_array(
+	utki::shared_ref<opengl::context> context,
 	buffers_type buffers,
 	utki::shared_ref<const ruis::render::index_buffer> indices,
 	mode rendering_mode
+) :
+	vertex_array(
+		std::move(context), //
+		std::move(buffers),
+		indices,
+		rendering_mode,
+		get_num_indices(indices.get())
+	)
+{}
+
+vertex_array::vertex_array(
+	utki::shared_ref<opengl::context> context,
+	buffers_type buffers,
+	utki::shared_ref<const ruis::render::index_buffer> indices,
+	mode rendering_mode,
+	GLsizei num_indices
 ) :
 	ruis::render::vertex_array(
 		std::move(buffers), //
 		std::move(indices),
 		rendering_mode
 	),
-	vao([]() {
-		if (GLEW_ARB_vertex_array_object) {
-			// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
-			GLuint ret;
-			glGenVertexArrays(1, &ret);
-			assert_opengl_no_error();
-			return ret;
-		} else {
+	context(std::move(context)),
+	vao([this]() {
+		if (!GLEW_ARB_vertex_array_object) {
 			return GLuint(0);
 		}
-	}())
+
+		// NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+		GLuint ret;
+		if (this->context.get().is_direct_state_access_enabled()) {
+			glCreateVertexArrays(1, &ret);
+		} else {
+			glGenVertexArrays(1, &ret);
+		}
+		assert_opengl_no_error();
+		return ret;
+	}()),
+	num_indices(num_indices)
 {
-	if (GLEW_ARB_vertex_array_object) {
+	if (num_indices < 0 || num_indices > get_num_indices(this->indices.get())) {
+		throw std::out_of_range("vertex_array: number of indices is out of the index buffer range");
+	}
+
+	if (!GLEW_ARB_vertex_array_object) {
+		return;
+	}
+
+	if (this->context.get().is_direct_state_access_enabled()) {
+		this->setup_vertex_array();
+	} else {
 		glBindVertexArray(this->vao);
 		assert_opengl_no_error();
 
@@ -67,31 +131,59 @@ vertex_array::vertex_array(
 
 vertex_array::~vertex_array()
 {
-	if (GLEW_ARB_vertex_array_object) {
-		glBindVertexArray(0);
-		assert_opengl_no_error();
-		glDeleteVertexArrays(1, &this->vao);
-		assert_opengl_no_error();
+	if (!GLEW_ARB_vertex_array_object) {
+		return;
+	}
+
+	if (!this->context.get().is_context_thread()) {
+		this->context.get().get_deletion_queue().push({
+			.type = deletion_queue::object_type::vertex_array,
+			.name = this->vao //
+		});
+		return;
 	}
+
+	glBindVertexArray(0);
+	assert_opengl_no_error();
+	glDeleteVertexArrays(1, &this->vao);
+	assert_opengl_no_error();
 }
 
 void vertex_array::bind_buffers() const
 {
-	for (unsigned i = 0; i != this->buffers.size(); ++i) {
-		ASSERT(dynamic_cast<const vertex_buffer*>(&this->buffers[i].get()))
+	// interleaved vertex buffers take several attribute locations
+	GLuint location = 0;
+
+	for (const auto& b : this->buffers) {
+		if (auto ivbo = dynamic_cast<const interleaved_vertex_buffer*>(&b.get())) {
+			ivbo->bind_attributes(location);
+			location += GLuint(ivbo->layout.attributes.size());
+			continue;
+		}
+
+		ASSERT(dynamic_cast<const vertex_buffer*>(&b.get()))
 		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
-		const auto& vbo = static_cast<const vertex_buffer&>(this->buffers[i].get());
+		const auto& vbo = static_cast<const vertex_buffer&>(b.get());
 		glBindBuffer(GL_ARRAY_BUFFER, vbo.buffer);
 		assert_opengl_no_error();
 
 		//		TRACE(<< "vbo.numComponents = " << vbo.numComponents << "
 		// vbo.type = " << vbo.type << std::endl)
 
-		glVertexAttribPointer(i, vbo.num_components, vbo.type, GL_FALSE, 0, nullptr);
+		glVertexAttribPointer(
+			location,
+			vbo.num_components,
+			vbo.type,
+			vbo.normalized ? GL_TRUE : GL_FALSE,
+			0,
+			vbo.get_offset_pointer()
+		);
 		assert_opengl_no_error();
 
-		glEnableVertexAttribArray(i);
+		glEnableVertexAttribArray(location);
 		assert_opengl_no_error();
+
+		++location;
 	}
 
 	{
@@ -102,3 +194,77 @@ void vertex_array::bind_buffers() const
 		assert_opengl_no_error();
 	}
 }
+
+void vertex_array::setup_vertex_array() const
+{
+	ASSERT(this->context.get().is_direct_state_access_enabled())
+
+	// Each vertex buffer is bound to the binding point with the number of its first attribute location.
+	// Interleaved vertex buffers take several attribute locations, so some binding points remain unused.
+	GLuint location = 0;
+
+	for (const auto& b : this->buffers) {
+		if (auto ivbo = dynamic_cast<const interleaved_vertex_buffer*>(&b.get())) {
+			GLuint binding = location;
+
+			glVertexArrayVertexBuffer(
+				this->vao,
+				binding,
+				ivbo->buffer,
+				GLintptr(ivbo->offset),
+				GLsizei(ivbo->layout.stride)
+			);
+			assert_opengl_no_error();
+
+			for (const auto& a : ivbo->layout.attributes) {
+				glVertexArrayAttribFormat(
+					this->vao,
+					location,
+					a.num_components,
+					a.type,
+					a.normalized ? GL_TRUE : GL_FALSE,
+					GLuint(a.offset)
+				);
+				glVertexArrayAttribBinding(this->vao, location, binding);
+				glEnableVertexArrayAttrib(this->vao, location);
+				assert_opengl_no_error();
+
+				++location;
+			}
+			continue;
+		}
+
+		ASSERT(dynamic_cast<const vertex_buffer*>(&b.get()))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		const auto& vbo = static_cast<const vertex_buffer&>(b.get());
+
+		glVertexArrayVertexBuffer(
+			this->vao,
+			location,
+			vbo.buffer,
+			GLintptr(vbo.offset),
+			vbo.num_components * to_type_size(vbo.type)
+		);
+		glVertexArrayAttribFormat(
+			this->vao,
+			location,
+			vbo.num_components,
+			vbo.type,
+			vbo.normalized ? GL_TRUE : GL_FALSE,
+			0 // relative offset
+		);
+		glVertexArrayAttribBinding(this->vao, location, location);
+		glEnableVertexArrayAttrib(this->vao, location);
+		assert_opengl_no_error();
+
+		++location;
+	}
+
+	{
+		ASSERT(dynamic_cast<const index_buffer*>(&this->indices.get()))
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast)
+		const auto& ivbo = static_cast<const index_buffer&>(this->indices.get());
+		glVertexArrayElementBuffer(this->vao, ivbo.buffer);
+		assert_opengl_no_error();
+	}
+}
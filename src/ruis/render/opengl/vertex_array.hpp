@@ -23,15 +23,50 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <GL/glew.h>
 #include <ruis/render/vertex_array.hpp>
+#include <utki/shared_ref.hpp>
+
+#include "context.hpp"
 
 namespace ruis::render::opengl {
 
 class vertex_array : public ruis::render::vertex_array
 {
+	const utki::shared_ref<opengl::context> context;
+
 public:
 	const GLuint vao;
 
-	vertex_array(buffers_type buffers, utki::shared_ref<const ruis::render::index_buffer> indices, mode rendering_mode);
+	/**
+	 * @brief Number of indices to draw.
+	 * Normally, it is the number of indices in the index buffer. But it can be less
+	 * in case the index buffer is shared by several vertex arrays,
+	 * see factory::create_quad_vertex_array().
+	 */
+	const GLsizei num_indices;
+
+	vertex_array(
+		utki::shared_ref<opengl::context> context,
+		buffers_type buffers,
+		utki::shared_ref<const ruis::render::index_buffer> indices,
+		mode rendering_mode
+	);
+
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param buffers - vertex buffers.
+	 * @param indices - index buffer.
+	 * @param rendering_mode - rendering mode.
+	 * @param num_indices - number of indices from the beginning of the index buffer to draw.
+	 * @throw std::out_of_range - if the index buffer has less indices than requested.
+	 */
+	vertex_array(
+		utki::shared_ref<opengl::context> context,
+		buffers_type buffers,
+		utki::shared_ref<const ruis::render::index_buffer> indices,
+		mode rendering_mode,
+		GLsizei num_indices
+	);
 
 	vertex_array(const vertex_array&) = delete;
 	vertex_array& operator=(const vertex_array&) = delete;
@@ -44,6 +79,8 @@ public:
 	void bind_buffers() const;
 
 private:
+	// sets up the vertex array object using direct state access, without binding it
+	void setup_vertex_array() const;
 };
 
 } // namespace ruis::render::opengl
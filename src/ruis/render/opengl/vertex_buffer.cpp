@@ -21,47 +21,381 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "vertex_buffer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <utki/debug.hpp>
+
 #include "util.hpp"
 
 using namespace ruis::render::opengl;
 
-void vertex_buffer::init(GLsizeiptr size, const GLvoid* data)
+namespace {
+template <typename vector_type>
+utki::span<const float> to_float_span(utki::span<const vector_type> vertices)
+{
+	static_assert(sizeof(vector_type) % sizeof(float) == 0, "vertex must consist of floats");
+	return utki::make_span(
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		reinterpret_cast<const float*>(vertices.data()),
+		vertices.size_bytes() / sizeof(float)
+	);
+}
+
+template <typename value_type>
+utki::span<const uint8_t> to_byte_span(utki::span<const value_type> values)
+{
+	return utki::make_span(
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		reinterpret_cast<const uint8_t*>(values.data()),
+		values.size_bytes()
+	);
+}
+
+vertex_format to_supported_format(vertex_format format)
+{
+	if (format == vertex_format::float16 && !GLEW_ARB_half_float_vertex) {
+		return vertex_format::float32;
+	}
+	return format;
+}
+
+GLenum to_gl_type(vertex_format format)
+{
+	switch (format) {
+		default:
+			ASSERT(false)
+			[[fallthrough]];
+		case vertex_format::float32:
+			return GL_FLOAT;
+		case vertex_format::float16:
+			return GL_HALF_FLOAT;
+		case vertex_format::int16:
+		case vertex_format::int16_normalized:
+			return GL_SHORT;
+		case vertex_format::uint16_normalized:
+			return GL_UNSIGNED_SHORT;
+		case vertex_format::uint8_normalized:
+			return GL_UNSIGNED_BYTE;
+	}
+}
+
+bool is_normalized(vertex_format format)
+{
+	switch (format) {
+		case vertex_format::int16_normalized:
+		case vertex_format::uint16_normalized:
+		case vertex_format::uint8_normalized:
+			return true;
+		default:
+			return false;
+	}
+}
+
+size_t component_size(vertex_format format)
+{
+	switch (format) {
+		default:
+			ASSERT(false)
+			[[fallthrough]];
+		case vertex_format::float32:
+			return sizeof(float);
+		case vertex_format::float16:
+		case vertex_format::int16:
+		case vertex_format::int16_normalized:
+		case vertex_format::uint16_normalized:
+			return sizeof(uint16_t);
+		case vertex_format::uint8_normalized:
+			return sizeof(uint8_t);
+	}
+}
+
+// IEEE 754 single to half precision conversion with rounding to nearest even
+uint16_t to_half(float value)
+{
+	uint32_t x = 0;
+	std::memcpy(&x, &value, sizeof(x));
+
+	constexpr auto exponent_mask = 0xff;
+	constexpr auto mantissa_bits = 23;
+	constexpr auto half_mantissa_bits = 10;
+	constexpr auto half_infinity = 0x7c00;
+	constexpr auto half_max_exponent = 0x1f;
+	constexpr auto exponent_bias_difference = 127 - 15;
+
+	auto sign = (x >> 16) & 0x8000;
+	auto mantissa = x & ((1U << mantissa_bits) - 1);
+	auto float_exponent = (x >> mantissa_bits) & exponent_mask;
+
+	if (float_exponent == exponent_mask) {
+		// infinity or NaN
+		return uint16_t(sign | half_infinity | (mantissa != 0 ? 0x200 : 0));
+	}
+
+	auto exponent = int32_t(float_exponent) - exponent_bias_difference;
+
+	if (exponent >= half_max_exponent) {
+		// overflow, convert to infinity
+		return uint16_t(sign | half_infinity);
+	}
+
+	if (exponent <= 0) {
+		// half subnormal number or zero
+		constexpr auto min_subnormal_exponent = -10;
+		if (exponent < min_subnormal_exponent) {
+			return uint16_t(sign);
+		}
+
+		// add the implicit leading 1
+		mantissa |= 1U << mantissa_bits;
+
+		auto shift = uint32_t(mantissa_bits - half_mantissa_bits + 1 - exponent);
+		auto half = mantissa >> shift;
+		auto remainder = mantissa & ((1U << shift) - 1);
+		auto halfway = 1U << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+			++half;
+		}
+		return uint16_t(sign | half);
+	}
+
+	constexpr auto shift = mantissa_bits - half_mantissa_bits;
+
+	auto half = sign | (uint32_t(exponent) << half_mantissa_bits) | (mantissa >> shift);
+	auto remainder = mantissa & ((1U << shift) - 1);
+	constexpr auto halfway = 1U << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+		// carry to exponent is correct, it rounds up to next power of two or to infinity
+		++half;
+	}
+	return uint16_t(half);
+}
+
+template <typename component_type, typename converter_type>
+std::vector<uint8_t> convert(utki::span<const float> values, converter_type converter)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
-	assert_opengl_no_error();
+	std::vector<uint8_t> ret(values.size() * sizeof(component_type));
+	auto* dst = ret.data();
+	for (auto v : values) {
+		component_type c = converter(v);
+		std::memcpy(dst, &c, sizeof(c));
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		dst += sizeof(c);
+	}
+	return ret;
+}
+
+// returns empty vector for float32 format, no conversion is needed in that case
+std::vector<uint8_t> to_format(utki::span<const float> values, vertex_format format)
+{
+	switch (to_supported_format(format)) {
+		default:
+		case vertex_format::float32:
+			return {};
+		case vertex_format::float16:
+			return convert<uint16_t>(values, to_half);
+		case vertex_format::int16:
+			return convert<int16_t>(values, [](float v) {
+				using limits = std::numeric_limits<int16_t>;
+				return int16_t(std::lround(std::clamp(v, float(limits::min()), float(limits::max()))));
+			});
+		case vertex_format::int16_normalized:
+			return convert<int16_t>(values, [](float v) {
+				return int16_t(std::lround(std::clamp(v, -1.0f, 1.0f) * float(std::numeric_limits<int16_t>::max())));
+			});
+		case vertex_format::uint16_normalized:
+			return convert<uint16_t>(values, [](float v) {
+				return uint16_t(std::lround(std::clamp(v, 0.0f, 1.0f) * float(std::numeric_limits<uint16_t>::max())));
+			});
+		case vertex_format::uint8_normalized:
+			return convert<uint8_t>(values, [](float v) {
+				return uint8_t(std::lround(std::clamp(v, 0.0f, 1.0f) * float(std::numeric_limits<uint8_t>::max())));
+			});
+	}
+}
+
+// extend the bounding box to include the vertices
+void extend_bounds(
+	vertex_buffer::bounding_box& box,
+	bool empty,
+	utki::span<const float> values,
+	size_t num_components
+)
+{
+	if (values.empty()) {
+		return;
+	}
+
+	auto n = std::min(num_components, size_t(3));
+
+	if (empty) {
+		for (size_t i = 0; i != n; ++i) {
+			box.min[i] = values[i];
+			box.max[i] = values[i];
+		}
+	}
+
+	for (size_t v = 0; v != values.size(); v += num_components) {
+		for (size_t i = 0; i != n; ++i) {
+			box.min[i] = std::min(box.min[i], values[v + i]);
+			box.max[i] = std::max(box.max[i], values[v + i]);
+		}
+	}
+}
+} // namespace
+
+vertex_buffer::vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const float> values,
+	GLint num_components,
+	bool keep_data,
+	buffer_usage usage,
+	vertex_format format,
+	std::vector<uint8_t> converted_values
+) :
+	ruis::render::vertex_buffer(values.size() / size_t(num_components)),
+	opengl_buffer(
+		std::move(context),
+		GL_ARRAY_BUFFER,
+		converted_values.empty() ? to_byte_span(values) : utki::make_span(std::as_const(converted_values)),
+		usage
+	),
+	format(to_supported_format(format)),
+	num_components(num_components),
+	type(to_gl_type(this->format)),
+	normalized(is_normalized(this->format)),
+	num_vertices(values.size() / size_t(num_components)),
+	data(keep_data ? std::vector<float>(values.begin(), values.end()) : std::vector<float>())
+{
+	extend_bounds(this->bounds, true, values, size_t(num_components));
+}
+
+vertex_buffer::vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const r4::vector4<float>> vertices,
+	bool keep_data,
+	buffer_usage usage,
+	vertex_format format
+) :
+	vertex_buffer(
+		std::move(context),
+		to_float_span(vertices),
+		4,
+		keep_data,
+		usage,
+		format,
+		to_format(to_float_span(vertices), format)
+	)
+{}
+
+vertex_buffer::vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const r4::vector3<float>> vertices,
+	bool keep_data,
+	buffer_usage usage,
+	vertex_format format
+) :
+	vertex_buffer(
+		std::move(context),
+		to_float_span(vertices),
+		3,
+		keep_data,
+		usage,
+		format,
+		to_format(to_float_span(vertices), format)
+	)
+{}
+
+vertex_buffer::vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const r4::vector2<float>> vertices,
+	bool keep_data,
+	buffer_usage usage,
+	vertex_format format
+) :
+	vertex_buffer(
+		std::move(context),
+		to_float_span(vertices),
+		2,
+		keep_data,
+		usage,
+		format,
+		to_format(to_float_span(vertices), format)
+	)
+{}
+
+vertex_buffer::vertex_buffer(
+	utki::shared_ref<opengl::context> context,
+	utki::span<const float> vertices,
+	bool keep_data,
+	buffer_usage usage,
+	vertex_format format
+) :
+	vertex_buffer(
+		std::move(context),
+		vertices,
+		1,
+		keep_data,
+		usage,
+		format,
+		to_format(vertices, format)
+	)
+{}
+
+void vertex_buffer::update_internal(utki::span<const float> values, GLint num_components, size_t offset)
+{
+	if (num_components != this->num_components) {
+		throw std::invalid_argument("vertex_buffer::update(): number of vertex components mismatch");
+	}
+
+	auto num_values = this->num_vertices * size_t(this->num_components);
+	auto offset_values = offset * size_t(this->num_components);
+
+	if (offset_values > num_values || values.size() > num_values - offset_values) {
+		throw std::out_of_range("vertex_buffer::update(): data does not fit into the buffer");
+	}
+
+	// recorded draws use the current contents of the buffer
+	this->context.get().flush();
+
+	bool whole_buffer = values.size() == num_values;
+
+	if (this->data.empty()) {
+		// without CPU-side copy the bounds can only grow, unless the whole buffer is updated
+		extend_bounds(this->bounds, whole_buffer, values, size_t(this->num_components));
+	} else {
+		std::copy(values.begin(), values.end(), std::next(this->data.begin(), std::ptrdiff_t(offset_values)));
+		extend_bounds(this->bounds, true, this->data, size_t(this->num_components));
+	}
+
+	auto converted_values = to_format(values, this->format);
 
-	glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-	assert_opengl_no_error();
+	this->write(
+		converted_values.empty() ? to_byte_span(values) : utki::make_span(std::as_const(converted_values)),
+		offset_values * component_size(this->format)
+	);
 }
 
-vertex_buffer::vertex_buffer(utki::span<const r4::vector4<float>> vertices) :
-	ruis::render::vertex_buffer(vertices.size()),
-	num_components(4),
-	type(GL_FLOAT)
+void vertex_buffer::update(utki::span<const r4::vector4<float>> vertices, size_t offset)
 {
-	this->init(GLsizeiptr(vertices.size_bytes()), vertices.data());
+	this->update_internal(to_float_span(vertices), 4, offset);
 }
 
-vertex_buffer::vertex_buffer(utki::span<const r4::vector3<float>> vertices) :
-	ruis::render::vertex_buffer(vertices.size()),
-	num_components(3),
-	type(GL_FLOAT)
+void vertex_buffer::update(utki::span<const r4::vector3<float>> vertices, size_t offset)
 {
-	this->init(GLsizeiptr(vertices.size_bytes()), vertices.data());
+	this->update_internal(to_float_span(vertices), 3, offset);
 }
 
-vertex_buffer::vertex_buffer(utki::span<const r4::vector2<float>> vertices) :
-	ruis::render::vertex_buffer(vertices.size()),
-	num_components(2),
-	type(GL_FLOAT)
+void vertex_buffer::update(utki::span<const r4::vector2<float>> vertices, size_t offset)
 {
-	this->init(GLsizeiptr(vertices.size_bytes()), vertices.data());
+	this->update_internal(to_float_span(vertices), 2, offset);
 }
 
-vertex_buffer::vertex_buffer(utki::span<const float> vertices) :
-	ruis::render::vertex_buffer(vertices.size()),
-	num_components(1),
-	type(GL_FLOAT)
+void vertex_buffer::update(utki::span<const float> vertices, size_t offset)
 {
-	this->init(GLsizeiptr(vertices.size_bytes()), vertices.data());
+	this->update_internal(vertices, 1, offset);
 }
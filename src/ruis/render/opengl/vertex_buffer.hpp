@@ -21,6 +21,8 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <vector>
+
 #include <r4/vector.hpp>
 #include <ruis/render/vertex_buffer.hpp>
 #include <utki/span.hpp>
@@ -29,21 +31,127 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 namespace ruis::render::opengl {
 
+/**
+ * @brief Format of vertex components stored in the vertex buffer.
+ * Vertex data is always given as floats, and converted to the storage format on upload.
+ * Compact formats reduce vertex memory and upload bandwidth.
+ */
+enum class vertex_format {
+	/**
+	 * @brief 32-bit float.
+	 */
+	float32,
+
+	/**
+	 * @brief 16-bit float.
+	 * If OpenGL does not support half float vertex attributes, float32 is used instead.
+	 */
+	float16,
+
+	/**
+	 * @brief 16-bit signed integer.
+	 * Values are rounded to nearest integer, e.g. pixel positions.
+	 */
+	int16,
+
+	/**
+	 * @brief 16-bit signed normalized integer.
+	 * Values are clamped to [-1, 1] range.
+	 */
+	int16_normalized,
+
+	/**
+	 * @brief 16-bit unsigned normalized integer.
+	 * Values are clamped to [0, 1] range, e.g. texture coordinates.
+	 */
+	uint16_normalized,
+
+	/**
+	 * @brief 8-bit unsigned normalized integer.
+	 * Values are clamped to [0, 1] range, e.g. colors.
+	 */
+	uint8_normalized
+};
+
 class vertex_buffer :
 	public ruis::render::vertex_buffer, //
 	public opengl_buffer
 {
 public:
+	const vertex_format format;
 	const GLint num_components;
 	const GLenum type;
+	const bool normalized;
+	const size_t num_vertices;
+
+	/**
+	 * @brief Axis aligned bounding box of the vertices.
+	 * Components which the vertices do not have are zero.
+	 * Used by command_list to find out whether draws overlap.
+	 */
+	struct bounding_box {
+		r4::vector3<float> min{0, 0, 0};
+		r4::vector3<float> max{0, 0, 0};
+	};
 
-	vertex_buffer(utki::span<const r4::vector4<float>> vertices);
+private:
+	std::vector<float> data;
 
-	vertex_buffer(utki::span<const r4::vector3<float>> vertices);
+	bounding_box bounds;
 
-	vertex_buffer(utki::span<const r4::vector2<float>> vertices);
+	vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const float> values,
+		GLint num_components,
+		bool keep_data,
+		buffer_usage usage,
+		vertex_format format,
+		std::vector<uint8_t> converted_values
+	);
 
-	vertex_buffer(utki::span<const float> vertices);
+	void update_internal(utki::span<const float> values, GLint num_components, size_t offset);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param context - OpenGL context.
+	 * @param vertices - vertex data.
+	 * @param keep_data - whether to keep CPU-side copy of the vertex data.
+	 *                    The copy is kept as floats regardless of the storage format.
+	 * @param usage - buffer usage hint.
+	 * @param format - storage format of the vertex components.
+	 */
+	vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const r4::vector4<float>> vertices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw,
+		vertex_format format = vertex_format::float32
+	);
+
+	vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const r4::vector3<float>> vertices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw,
+		vertex_format format = vertex_format::float32
+	);
+
+	vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const r4::vector2<float>> vertices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw,
+		vertex_format format = vertex_format::float32
+	);
+
+	vertex_buffer(
+		utki::shared_ref<opengl::context> context,
+		utki::span<const float> vertices,
+		bool keep_data = false,
+		buffer_usage usage = buffer_usage::static_draw,
+		vertex_format format = vertex_format::float32
+	);
 
 	vertex_buffer(const vertex_buffer&) = delete;
 	vertex_buffer& operator=(const vertex_buffer&) = delete;
@@ -53,8 +161,43 @@ public:
 
 	~vertex_buffer() override = default;
 
-private:
-	void init(GLsizeiptr size, const GLvoid* data);
+	/**
+	 * @brief Get CPU-side copy of the vertex data.
+	 * The copy is kept only for vertex buffers which can be batched, see batcher.
+	 * @return CPU-side copy of the vertex data.
+	 * @return empty span if the copy is not kept.
+	 */
+	utki::span<const float> get_data() const noexcept
+	{
+		return this->data;
+	}
+
+	const bounding_box& get_bounds() const noexcept
+	{
+		return this->bounds;
+	}
+
+	/**
+	 * @brief Update vertex data.
+	 * The number of vertex components must match the one of the vertex buffer.
+	 * The data is converted to the storage format of the vertex buffer.
+	 * The vertex buffer size cannot be changed.
+	 * If the whole buffer is updated and the buffer is not suballocated, its storage is orphaned
+	 * and re-specified, so that the update does not wait for pending draws which use the old contents.
+	 * Otherwise, the data is updated with glBufferSubData().
+	 * In deferred rendering mode the recorded commands are executed before updating.
+	 * @param vertices - new vertex data.
+	 * @param offset - offset in vertices from the beginning of the buffer.
+	 * @throw std::invalid_argument - if number of vertex components does not match.
+	 * @throw std::out_of_range - if the data does not fit into the buffer.
+	 */
+	void update(utki::span<const r4::vector4<float>> vertices, size_t offset = 0);
+
+	void update(utki::span<const r4::vector3<float>> vertices, size_t offset = 0);
+
+	void update(utki::span<const r4::vector2<float>> vertices, size_t offset = 0);
+
+	void update(utki::span<const float> vertices, size_t offset = 0);
 };
 
 } // namespace ruis::render::opengl